@@ -2,8 +2,18 @@
 #define __IMD_COMBINATORICS_
 
 #include <cmath>
+#include <cstdint>
 #include <string>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <array>
+#include <utility>
+#include <type_traits>
+#include <memory_resource>
+#if __has_include(<span>)
+#include <span>
+#endif
 
 namespace IMD
 {
@@ -77,70 +87,391 @@ namespace IMD
         void reset() noexcept;
     };
 
-    struct Fibonacci_numbers
+    // Integer modulo the compile time modulus, usable as the element type of linear_recurrence
+    template <unsigned long long Modulus>
+    struct modular_integer
     {
-    public:
-        using index_type = std::size_t;
-        using element_type = long;
+        static_assert(Modulus > 0 && Modulus <= 0xFFFFFFFFULL, "The modulus has to be in [1, 2^32)");
 
     private:
-        index_type __curr_index;
-        element_type __curr, __next;
+        unsigned long long __value;
 
     public:
-        Fibonacci_numbers(index_type start_index = 0);
+        constexpr modular_integer(long long value = 0) noexcept
+            : __value(value >= 0 ? static_cast<unsigned long long>(value) % Modulus
+                                 : (Modulus - static_cast<unsigned long long>(-(value + 1)) % Modulus - 1) % Modulus) {}
+
+        constexpr unsigned long long value() const noexcept { return this->__value; }
+        static constexpr unsigned long long modulus() noexcept { return Modulus; }
+
+        constexpr modular_integer &operator+=(modular_integer other) noexcept
+        {
+            this->__value += other.__value;
+            if (this->__value >= Modulus)
+                this->__value -= Modulus;
+            return *this;
+        }
+        constexpr modular_integer &operator-=(modular_integer other) noexcept
+        {
+            this->__value += Modulus - other.__value;
+            if (this->__value >= Modulus)
+                this->__value -= Modulus;
+            return *this;
+        }
+        constexpr modular_integer &operator*=(modular_integer other) noexcept
+        {
+            this->__value = this->__value * other.__value % Modulus;
+            return *this;
+        }
+        // Warning: the divisor has to be coprime with the modulus
+        constexpr modular_integer &operator/=(modular_integer other) noexcept
+        {
+            long long old_r(other.__value), r(Modulus), old_s(1), s(0);
+            while (r != 0)
+            {
+                const long long q = old_r / r, tmp_r = old_r - q * r, tmp_s = old_s - q * s;
+                old_r = r, r = tmp_r;
+                old_s = s, s = tmp_s;
+            }
+            return *this *= modular_integer(old_s);
+        }
+
+        friend constexpr modular_integer operator+(modular_integer a, modular_integer b) noexcept { return a += b; }
+        friend constexpr modular_integer operator-(modular_integer a, modular_integer b) noexcept { return a -= b; }
+        friend constexpr modular_integer operator*(modular_integer a, modular_integer b) noexcept { return a *= b; }
+        friend constexpr modular_integer operator/(modular_integer a, modular_integer b) noexcept { return a /= b; }
+
+        friend constexpr bool operator==(modular_integer a, modular_integer b) noexcept { return a.__value == b.__value; }
+        friend constexpr bool operator!=(modular_integer a, modular_integer b) noexcept { return a.__value != b.__value; }
+
+        friend std::ostream &operator<<(std::ostream &os, modular_integer a) { return os << a.__value; }
+    };
 
-        Fibonacci_numbers(const Fibonacci_numbers &other);
-        Fibonacci_numbers(Fibonacci_numbers &&other) noexcept;
+    template <long long... Coefficients>
+    struct recurrence_coefficients
+    {
+    };
+    template <long long... Values>
+    struct recurrence_initial_values
+    {
+    };
 
-        Fibonacci_numbers &operator=(const Fibonacci_numbers &other);
-        Fibonacci_numbers &operator=(Fibonacci_numbers &&other) noexcept;
+    // Signed built-in elements are computed in the unsigned type: the wrapping arithmetic gives the exact value whenever it fits,
+    // while the jump coefficients and the window values past the current index may overflow the signed type
+    template <typename T, bool = std::is_integral<T>::value && std::is_signed<T>::value>
+    struct recurrence_arithmetic
+    {
+        using type = T;
+    };
+    template <typename T>
+    struct recurrence_arithmetic<T, true>
+    {
+        using type = typename std::make_unsigned<T>::type;
+    };
 
-        bool operator==(const Fibonacci_numbers &other);
-        bool operator!=(const Fibonacci_numbers &other);
+    namespace instrumentation
+    {
+        // Probes of linear_recurrence::goto_index. The template calls these library functions instead of the counters of
+        // instrumentation.h, so its definition doesn't depend on the flags of the including translation unit: they do nothing
+        // unless the library itself is built with IMD_COMBINATORICS_INSTRUMENTATION
+        enum class recurrence_probe : unsigned char
+        {
+            Fibonacci,
+            Luka,
+            linear_recurrence
+        };
+
+        // The start time of the outermost call (0 when disabled), to be passed to recurrence_leave
+        std::uint64_t recurrence_enter(recurrence_probe p) noexcept;
+        void recurrence_leave(recurrence_probe p, std::uint64_t start, std::uint64_t steps, bool overflow) noexcept;
+    }
 
-        element_type current() const noexcept;
-        index_type index() const noexcept;
+    // Max_index is the largest index whose value fits into the element type, goto_index past it counts an overflow of the probe
+    template <typename Element, typename Coefficients, typename Initial_values,
+              instrumentation::recurrence_probe Probe = instrumentation::recurrence_probe::linear_recurrence,
+              std::size_t Max_index = SIZE_MAX>
+    struct linear_recurrence;
+
+    // a(n + K) = c_1 * a(n + K - 1) + ... + c_K * a(n), a(0..K - 1) are the initial values.
+    // goto_index jumps with Kitamasa's method (x^n modulo the characteristic polynomial) in O(K^2 log n),
+    // previous() divides by c_K, so it needs c_K to be invertible in the element type
+    template <typename Element, long long... Coefficients, long long... Values, instrumentation::recurrence_probe Probe, std::size_t Max_index>
+    struct linear_recurrence<Element, recurrence_coefficients<Coefficients...>, recurrence_initial_values<Values...>, Probe, Max_index>
+    {
+        static_assert(sizeof...(Coefficients) > 0, "The recurrence needs at least one coefficient");
+        static_assert(sizeof...(Coefficients) == sizeof...(Values), "The amounts of the coefficients and the initial values differ");
 
-        void next() noexcept;
-        void previous() noexcept;
-        void goto_index(index_type index) noexcept;
+    public:
+        using index_type = std::size_t;
+        using element_type = Element;
 
-        void reset() noexcept;
+        static constexpr size_t order = sizeof...(Coefficients);
+
+    private:
+        using window_type = std::array<element_type, order>;
+        using arithmetic_type = typename recurrence_arithmetic<element_type>::type;
+        using polynomial_type = std::array<arithmetic_type, order>;
+        static constexpr std::array<long long, order> __coefficients = {Coefficients...}; // c_1, ..., c_K
+
+        index_type __curr_index;
+        window_type __window; // a(n), ..., a(n + K - 1)
+
+        static constexpr window_type initial_window() noexcept
+        {
+            return window_type{element_type(Values)...};
+        }
+
+        // c_1 * a(n + K - 1) + ... + c_K * a(n), unrolled at compile time
+        template <size_t... I>
+        element_type next_value(std::index_sequence<I...>) const noexcept
+        {
+            return element_type((arithmetic_type(0) + ... +
+                                 (arithmetic_type(__coefficients[I]) * arithmetic_type(this->__window[order - 1 - I]))));
+        }
+
+        // a * b modulo the characteristic polynomial, both of degree < K
+        static polynomial_type multiply(const polynomial_type &a, const polynomial_type &b) noexcept
+        {
+            std::array<arithmetic_type, 2 * order - 1> prod{};
+            for (size_t i(0); i < order; ++i)
+                for (size_t j(0); j < order; ++j)
+                    prod[i + j] = prod[i + j] + a[i] * b[j];
+
+            // x^K = c_1 * x^(K - 1) + ... + c_K
+            for (size_t i(2 * order - 1); i-- > order;)
+                for (size_t j(1); j <= order; ++j)
+                    prod[i - j] = prod[i - j] + prod[i] * arithmetic_type(__coefficients[j - 1]);
+
+            polynomial_type res;
+            for (size_t i(0); i < order; ++i)
+                res[i] = prod[i];
+            return res;
+        }
+
+        static polynomial_type shift(const polynomial_type &a) noexcept
+        {
+            polynomial_type res{};
+            for (size_t i(order - 1); i > 0; --i)
+                res[i] = a[i - 1];
+            for (size_t j(1); j <= order; ++j)
+                res[order - j] = res[order - j] + a[order - 1] * arithmetic_type(__coefficients[j - 1]);
+            return res;
+        }
+
+        void jump(index_type index) noexcept
+        {
+            // x^index modulo the characteristic polynomial, the base isn't squared past the top bit of the index
+            polynomial_type poly{}, base{};
+            poly[0] = arithmetic_type(1);
+            if (order == 1)
+                base[0] = arithmetic_type(__coefficients[0]);
+            else
+                base[1] = arithmetic_type(1);
+
+            for (index_type e(index); e > 0; e >>= 1)
+            {
+                if (e & 1)
+                    poly = multiply(poly, base);
+                if (e > 1)
+                    base = multiply(base, base);
+            }
+
+            const window_type init = initial_window();
+            for (size_t i(0); i < order; ++i)
+            {
+                arithmetic_type value(0);
+                for (size_t j(0); j < order; ++j)
+                    value = value + poly[j] * arithmetic_type(init[j]);
+                this->__window[i] = element_type(value);
+                poly = shift(poly);
+            }
+            this->__curr_index = index;
+        }
+
+        // Stepping costs K per step, a jump about 4 K^2 log2(index)
+        static bool worth_jump(index_type distance, index_type index) noexcept
+        {
+            index_type bits(1);
+            while ((index >> bits) != 0)
+                ++bits;
+            return distance > 4 * order * bits;
+        }
+
+        // goto_index without the probes, returns the amount of previous() steps
+        index_type move_to(index_type index) noexcept
+        {
+            if (index == this->__curr_index)
+                return 0;
+
+            if (index < this->__curr_index)
+            {
+                const index_type steps_backward = this->__curr_index - index;
+                if (worth_jump(steps_backward, index))
+                {
+                    this->jump(index);
+                    return 0;
+                }
+                while (this->__curr_index > index)
+                    this->previous();
+                return steps_backward;
+            }
+
+            if (worth_jump(index - this->__curr_index, index))
+                this->jump(index);
+            else
+                while (this->__curr_index < index)
+                    this->next();
+            return 0;
+        }
+
+    public:
+        linear_recurrence(index_type start_index = 0)
+            : __curr_index(0), __window(initial_window())
+        {
+            this->goto_index(start_index);
+        }
+
+        linear_recurrence(const linear_recurrence &other)
+            : __curr_index(other.__curr_index), __window(other.__window) {}
+        linear_recurrence(linear_recurrence &&other) noexcept
+            : __curr_index(std::move(other.__curr_index)), __window(std::move(other.__window)) {}
+
+        linear_recurrence &operator=(const linear_recurrence &other)
+        {
+            if (this != &other)
+            {
+                this->__curr_index = other.__curr_index;
+                this->__window = other.__window;
+            }
+            return *this;
+        }
+        linear_recurrence &operator=(linear_recurrence &&other) noexcept
+        {
+            this->__curr_index = std::move(other.__curr_index);
+            this->__window = std::move(other.__window);
+            return *this;
+        }
+
+        bool operator==(const linear_recurrence &other)
+        {
+            return this->__curr_index == other.__curr_index;
+        }
+        bool operator!=(const linear_recurrence &other)
+        {
+            return !this->operator==(other);
+        }
+
+        element_type current() const noexcept
+        {
+            return this->__window[0];
+        }
+        index_type index() const noexcept
+        {
+            return this->__curr_index;
+        }
+
+        void next() noexcept
+        {
+            const element_type value = this->next_value(std::make_index_sequence<order>{});
+            for (size_t i(0); i + 1 < order; ++i)
+                this->__window[i] = this->__window[i + 1];
+            this->__window[order - 1] = value;
+            ++this->__curr_index;
+        }
+        void previous() noexcept
+        {
+            if (this->__curr_index == 0)
+                return;
+
+            // c_K * a(n - 1) = a(n + K - 1) - c_1 * a(n + K - 2) - ... - c_(K - 1) * a(n), exact while c_K * a(n - 1) fits
+            arithmetic_type numerator = arithmetic_type(this->__window[order - 1]);
+            for (size_t j(1); j < order; ++j)
+                numerator = numerator - arithmetic_type(__coefficients[j - 1]) * arithmetic_type(this->__window[order - 1 - j]);
+            const element_type value = element_type(numerator) / element_type(__coefficients[order - 1]);
+
+            for (size_t i(order - 1); i > 0; --i)
+                this->__window[i] = this->__window[i - 1];
+            this->__window[0] = value;
+            --this->__curr_index;
+        }
+
+        void goto_index(index_type index) noexcept
+        {
+            const std::uint64_t start = instrumentation::recurrence_enter(Probe);
+            const index_type steps = this->move_to(index);
+            instrumentation::recurrence_leave(Probe, start, steps, index > Max_index);
+        }
+
+        void reset() noexcept
+        {
+            this->__curr_index = 0;
+            this->__window = initial_window();
+        }
     };
 
-    struct Luka_numbers
+    // The last template arguments are the largest indices fitting into 'long'
+    using Fibonacci_numbers = linear_recurrence<long, recurrence_coefficients<1, 1>, recurrence_initial_values<0, 1>,
+                                                instrumentation::recurrence_probe::Fibonacci, sizeof(long) == 8 ? 92 : 46>;
+    using Luka_numbers = linear_recurrence<long, recurrence_coefficients<1, 1>, recurrence_initial_values<2, 1>,
+                                           instrumentation::recurrence_probe::Luka, sizeof(long) == 8 ? 90 : 44>;
+    using Pell_numbers = linear_recurrence<long, recurrence_coefficients<2, 1>, recurrence_initial_values<0, 1>,
+                                           instrumentation::recurrence_probe::linear_recurrence, sizeof(long) == 8 ? 50 : 25>;
+    using Jacobsthal_numbers = linear_recurrence<long, recurrence_coefficients<1, 2>, recurrence_initial_values<0, 1>,
+                                                 instrumentation::recurrence_probe::linear_recurrence, sizeof(long) == 8 ? 64 : 32>;
+    using tribonacci_numbers = linear_recurrence<long, recurrence_coefficients<1, 1, 1>, recurrence_initial_values<0, 0, 1>,
+                                                 instrumentation::recurrence_probe::linear_recurrence, sizeof(long) == 8 ? 74 : 38>;
+
+    // F(n) mod m and L(n) mod m for huge n: fast doubling with Barrett reduction, n is reduced by the cached Pisano period first.
+    // The moduli have to be in [1, 2^32)
+    struct Fibonacci_modulo_solver
     {
     public:
-        using index_type = std::size_t;
-        using element_type = long;
+        using index_type = unsigned long long;
+        using element_type = unsigned long long;
+
+        // Amount of queries with odd moduli below 2^31 processed in lockstep by the batch functions (Montgomery form, vectorizable lanes)
+        static constexpr size_t batch_lanes = 8;
 
     private:
-        index_type __curr_index;
-        element_type __curr, __next;
+        struct modulus_context
+        {
+            element_type modulus;
+            element_type reciprocal; // floor((2^64 - 1) / modulus) for Barrett reduction
+            index_type period;
+            element_type Montgomery_inverse; // -modulus^-1 mod 2^32 for odd moduli below 2^31 (the batches)
+            element_type Montgomery_one;     // 2^32 mod modulus
+        };
+
+        std::unordered_map<element_type, modulus_context> __contexts;
+
+        const modulus_context &context(element_type modulus);
 
     public:
-        Luka_numbers(index_type start_index = 0);
+        Fibonacci_modulo_solver() = default;
 
-        Luka_numbers(const Luka_numbers &other);
-        Luka_numbers(Luka_numbers &&other) noexcept;
+        Fibonacci_modulo_solver(const Fibonacci_modulo_solver &other);
+        Fibonacci_modulo_solver(Fibonacci_modulo_solver &&other) noexcept;
 
-        Luka_numbers &operator=(const Luka_numbers &other);
-        Luka_numbers &operator=(Luka_numbers &&other) noexcept;
+        Fibonacci_modulo_solver &operator=(const Fibonacci_modulo_solver &other);
+        Fibonacci_modulo_solver &operator=(Fibonacci_modulo_solver &&other) noexcept;
 
-        bool operator==(const Luka_numbers &other);
-        bool operator!=(const Luka_numbers &other);
+        index_type Pisano_period(element_type modulus);
 
-        element_type current() const noexcept;
-        index_type index() const noexcept;
+        element_type Fibonacci(index_type n, element_type modulus);
+        element_type Luka(index_type n, element_type modulus);
 
-        void next() noexcept;
-        void previous() noexcept;
-        void goto_index(index_type index) noexcept;
+        // out[i] = F(indices[i]) mod moduli[i] (L(indices[i]) mod moduli[i] respectively)
+        void Fibonacci(const index_type *indices, const element_type *moduli, element_type *out, size_t amount);
+        void Luka(const index_type *indices, const element_type *moduli, element_type *out, size_t amount);
 
-        void reset() noexcept;
+        size_t cached_moduli() const noexcept;
+        void clear() noexcept;
     };
 
+    // The functions use the thread local solver, so the periods are shared between calls of the same thread
+    unsigned long long Fibonacci_modulo(unsigned long long n, unsigned long long modulus);
+    unsigned long long Luka_modulo(unsigned long long n, unsigned long long modulus);
+
     struct Catalan_numbers
     {
     public:
@@ -177,10 +508,173 @@ namespace IMD
     unsigned long long **Pascal_triangle(size_t rows_amount);
     // Warning: if the methods is called, then dinamic memory will be allocated - don't forget to free it
     unsigned long long *Pascal_triangle_row(size_t row_index);
+    // Allocation free: writes the row into 'out', which has to hold at least row_index + 1 elements
+    void Pascal_triangle_row(size_t row_index, unsigned long long *out, size_t capacity);
+#ifdef __cpp_lib_span
+    void Pascal_triangle_row(size_t row_index, std::span<unsigned long long> out);
+#endif
+
+    // The memory is taken from 'resource', e.g. std::pmr::monotonic_buffer_resource or std::pmr::unsynchronized_pool_resource
+    std::pmr::vector<std::pmr::vector<unsigned long long>> Pascal_triangle(size_t rows_amount, std::pmr::memory_resource *resource);
+    std::pmr::vector<unsigned long long> Pascal_triangle_row(size_t row_index, std::pmr::memory_resource *resource);
 
     unsigned long long Pascal_binomial_coefficient(size_t k, size_t n);
+
+    // The products are reduced by gcd before multiplying, so the result is exact whenever it fits in 64 bits
     unsigned long long iterative_binomial_coefficient(size_t k, size_t n);
 
+    // C(n, k) mod 2 and mod 3 via Lucas' theorem
+    constexpr unsigned binomial_coefficient_mod2(unsigned long long k, unsigned long long n)
+    {
+        return (k & n) == k ? 1 : 0;
+    }
+    constexpr unsigned binomial_coefficient_mod3(unsigned long long k, unsigned long long n)
+    {
+        if (k > n)
+            return 0;
+
+        unsigned res(1);
+        for (; k > 0 && res != 0; k /= 3, n /= 3)
+        {
+            const unsigned k_i = k % 3, n_i = n % 3;
+            if (k_i > n_i)
+                return 0;
+            if (n_i == 2 && k_i == 1) // C(2, 1) = 2
+                res = 3 - res;
+        }
+        return res;
+    }
+
+    // Row of Pascal triangle modulo 2, one bit per element (Sierpinski triangle)
+    struct Pascal_row_mod2
+    {
+    public:
+        using index_type = std::size_t;
+        using word_type = std::uint64_t;
+
+        static constexpr size_t cells_per_word = 64;
+
+    private:
+        index_type __curr_index;
+        std::vector<word_type> __words;
+
+    public:
+        Pascal_row_mod2(index_type start_index = 0);
+
+        Pascal_row_mod2(const Pascal_row_mod2 &other);
+        Pascal_row_mod2(Pascal_row_mod2 &&other) noexcept;
+
+        Pascal_row_mod2 &operator=(const Pascal_row_mod2 &other);
+        Pascal_row_mod2 &operator=(Pascal_row_mod2 &&other) noexcept;
+
+        bool operator==(const Pascal_row_mod2 &other);
+        bool operator!=(const Pascal_row_mod2 &other);
+
+        index_type index() const noexcept;
+        unsigned operator[](index_type k) const noexcept;
+        const std::vector<word_type> &words() const noexcept;
+        // The amount of odd elements: 2^(popcount(n))
+        size_t odd_amount() const noexcept;
+
+        // row(n + 1) = row(n) ^ (row(n) << 1)
+        void next();
+        // Builds the row directly from the submasks of the index
+        void goto_index(index_type index);
+
+        void reset();
+    };
+
+    // Row of Pascal triangle modulo 3, two bits per element
+    struct Pascal_row_mod3
+    {
+    public:
+        using index_type = std::size_t;
+        using word_type = std::uint64_t;
+
+        static constexpr size_t cells_per_word = 32;
+
+    private:
+        index_type __curr_index;
+        std::vector<word_type> __words;
+
+    public:
+        Pascal_row_mod3(index_type start_index = 0);
+
+        Pascal_row_mod3(const Pascal_row_mod3 &other);
+        Pascal_row_mod3(Pascal_row_mod3 &&other) noexcept;
+
+        Pascal_row_mod3 &operator=(const Pascal_row_mod3 &other);
+        Pascal_row_mod3 &operator=(Pascal_row_mod3 &&other) noexcept;
+
+        bool operator==(const Pascal_row_mod3 &other);
+        bool operator!=(const Pascal_row_mod3 &other);
+
+        index_type index() const noexcept;
+        unsigned operator[](index_type k) const noexcept;
+        const std::vector<word_type> &words() const noexcept;
+
+        // row(n + 1) = row(n) + (row(n) << 1 cell), the cells are added modulo 3 in parallel
+        void next();
+        void goto_index(index_type index);
+
+        void reset();
+    };
+
+    // Packed rows [0, rows_amount) in the formats of Pascal_row_mod2 and Pascal_row_mod3
+    std::vector<std::vector<std::uint64_t>> Pascal_triangle_mod2(size_t rows_amount);
+    std::vector<std::vector<std::uint64_t>> Pascal_triangle_mod3(size_t rows_amount);
+
+    // C(n, k) modulo arbitrary modulus for huge n: Lucas' theorem for primes, Granville's theorem for prime powers, CRT for the rest.
+    // Per prime power tables are cached inside the solver, so repeated queries cost O(log_p n)
+    struct binomial_modulo_solver
+    {
+    public:
+        using index_type = unsigned long long;
+        using element_type = unsigned long long;
+
+        // Upper bound of a single prime power table (the table holds p^e elements)
+        static constexpr element_type max_table_modulus = 1ULL << 22;
+
+    private:
+        struct prime_power_table
+        {
+            element_type prime, modulus;
+            size_t exponent;
+            std::vector<element_type> factorials;         // product of numbers in [1, i] coprime to the prime, modulo p^e
+            std::vector<element_type> inverse_factorials; // only for exponent == 1 (Lucas)
+        };
+
+        std::unordered_map<element_type, prime_power_table> __tables;          // p^e -> table
+        std::unordered_map<element_type, std::vector<element_type>> __moduli; // m -> prime powers of m, none if one is too large
+
+        const prime_power_table &table(element_type prime, size_t exponent);
+        const std::vector<element_type> &factorization(element_type modulus);
+
+        element_type Lucas(index_type k, index_type n, const prime_power_table &t) const noexcept;
+        element_type Granville(index_type k, index_type n, const prime_power_table &t) const noexcept;
+
+    public:
+        binomial_modulo_solver() = default;
+
+        binomial_modulo_solver(const binomial_modulo_solver &other);
+        binomial_modulo_solver(binomial_modulo_solver &&other) noexcept;
+
+        binomial_modulo_solver &operator=(const binomial_modulo_solver &other);
+        binomial_modulo_solver &operator=(binomial_modulo_solver &&other) noexcept;
+
+        element_type Lucas(index_type k, index_type n, element_type prime);
+        element_type Granville(index_type k, index_type n, element_type prime, size_t exponent);
+        element_type binomial(index_type k, index_type n, element_type modulus);
+
+        size_t cached_tables() const noexcept;
+        void clear() noexcept;
+    };
+
+    // The functions use the thread local solver, so the tables are shared between calls of the same thread
+    unsigned long long Lucas_binomial_coefficient(unsigned long long k, unsigned long long n, unsigned long long prime);
+    unsigned long long Granville_binomial_coefficient(unsigned long long k, unsigned long long n, unsigned long long prime, size_t exponent);
+    unsigned long long modular_binomial_coefficient(unsigned long long k, unsigned long long n, unsigned long long modulus);
+
     constexpr unsigned long long recursive_factorial(size_t num)
     {
         if (num == 0 || num == 1)
@@ -195,6 +689,101 @@ namespace IMD
         return res;
     }
 
+    // Arbitrary precision unsigned integer (little endian limbs of 32 bits), used for exact factorials and multinomials
+    struct big_unsigned
+    {
+    public:
+        using limb_type = std::uint32_t;
+
+    private:
+        std::vector<limb_type> __limbs; // without leading zeros, zero is an empty vector
+
+    public:
+        big_unsigned(unsigned long long value = 0);
+        explicit big_unsigned(std::vector<limb_type> limbs);
+
+        big_unsigned(const big_unsigned &other);
+        big_unsigned(big_unsigned &&other) noexcept;
+
+        big_unsigned &operator=(const big_unsigned &other);
+        big_unsigned &operator=(big_unsigned &&other) noexcept;
+
+        bool operator==(const big_unsigned &other) const noexcept;
+        bool operator!=(const big_unsigned &other) const noexcept;
+
+        big_unsigned &operator+=(const big_unsigned &other);
+
+        big_unsigned &operator*=(limb_type factor);
+        big_unsigned &operator*=(const big_unsigned &other);
+        big_unsigned operator*(const big_unsigned &other) const;
+
+        // Multiplication splitting the top Karatsuba levels across 'threads' threads
+        static big_unsigned multiply(const big_unsigned &lhs, const big_unsigned &rhs, size_t threads = 1);
+
+        const std::vector<limb_type> &limbs() const noexcept;
+        size_t bits() const noexcept;
+        bool is_zero() const noexcept;
+
+        // Warning: the conversion is quadratic in the amount of limbs
+        std::string to_string() const;
+    };
+
+    // Segmented sieve of Eratosthenes
+    std::vector<size_t> primes_up_to(size_t n);
+    // The exponent of 'prime' in n!, throws for prime < 2
+    size_t Legendre_exponent(size_t n, size_t prime);
+
+    // Prime-swing factorial: n! = ((n / 2)!)^2 * swing(n), every swing(n) is a balanced product tree of prime powers
+    big_unsigned big_factorial(size_t n, size_t threads = 1);
+    // (k_1 + ... + k_m)! / (k_1! * ... * k_m!) built from the subtracted Legendre exponents, without any division
+    big_unsigned big_multinomial_coefficient(const std::vector<size_t> &parts, size_t threads = 1);
+
+#ifdef __SIZEOF_INT128__
+    using uint128 = unsigned __int128;
+
+    std::string to_string(uint128 value);
+
+    // Exact results up to 128 bits: C(n, k) up to n = 130, n! up to 34!. Throw std::overflow_error above 128 bits
+    uint128 binomial_coefficient_128(size_t k, size_t n);
+    uint128 factorial_128(size_t n);
+    uint128 surjective_mappings_128(size_t n, size_t m);
+
+    // The narrowest exact representation of a result, the width is picked by a cheap bound before computing
+    struct exact_unsigned
+    {
+        enum class width_type
+        {
+            bits_64,
+            bits_128,
+            arbitrary
+        };
+
+        width_type width = width_type::bits_64;
+        uint128 value = 0; // bits_64 and bits_128
+        big_unsigned big;  // arbitrary
+
+        std::string to_string() const;
+    };
+
+    exact_unsigned exact_binomial_coefficient(size_t k, size_t n, size_t threads = 1);
+    exact_unsigned exact_factorial(size_t n, size_t threads = 1);
+    exact_unsigned exact_surjective_mappings(size_t n, size_t m);
+#endif
+
+    // Natural logarithms for probability computations. log k! is tabulated for k < 256, larger arguments use the Stirling series
+    // of lgamma. log C(n, k) is taken as lgamma(n + 1) - lgamma(n - k + 1) = (a - 1/2) log1p(k / a) + k (log(n + 1) - 1) + ...
+    // with a = n - k + 1 for min(k, n - k) < 256 and as k log(n / k) - (n - k) log1p(-k / n) + ... otherwise, so the large
+    // log factorials never cancel. Measured against a 113-bit lgamma for n <= 10^9: log n! within 4e-16 relative error,
+    // log C(n, k) within 2e-15 relative error for n >= 256 and within 3e-13 absolute error for n < 256 (tabulated differences)
+    double log_factorial(unsigned long long n) noexcept;
+    double log_binomial_coefficient(unsigned long long k, unsigned long long n);
+    double log_multinomial_coefficient(const std::vector<size_t> &parts) noexcept;
+
+    // out[i] = log_factorial(n[i]) and out[i] = log_binomial_coefficient(k[i], n[i]) within the same errors. The series run
+    // branch free on a vectorizable log, with GCC on x86-64 Linux in an AVX2 or a baseline version picked at load time
+    void log_factorials(const unsigned long long *n, size_t amount, double *out) noexcept;
+    void log_binomial_coefficients(const unsigned long long *k, const unsigned long long *n, size_t amount, double *out);
+
     constexpr unsigned long long non_negative_power_of_two(long long power)
     {
         return 1 << power;
@@ -207,6 +796,28 @@ namespace IMD
     void Hanoi_classic_iterative_problem(size_t n, char from, char to, char aux, int &moves, std::ostream &os = std::cout, const char *sep = " ");
     void Hanoi_restricted_recursive_problem(size_t n, char from, char to, char aux, int &moves, std::ostream &os = std::cout, const char *sep = " ");
 
+    struct Hanoi_move
+    {
+        size_t disk;
+        char from, to;
+    };
+    // The move with the zero based 'index' of Hanoi_classic_recursive_problem in O(n), without generating the previous ones
+    Hanoi_move Hanoi_classic_move_at(size_t n, unsigned long long index, char from = 'A', char to = 'C', char aux = 'B');
+
+    // Inverse queries, configuration[i] is the peg of the disk i + 1 (the smallest disk first), n <= 63
+    constexpr unsigned long long Hanoi_off_path = ~0ULL;
+    // The amount of moves of Hanoi_classic_recursive_problem made before the configuration or Hanoi_off_path
+    unsigned long long Hanoi_classic_index(const char *configuration, size_t n, char from = 'A', char to = 'C', char aux = 'B');
+    // The least amount of moves between two arbitrary configurations (Hinz: min of the direct and the detour moves of the largest different disk)
+    unsigned long long Hanoi_classic_distance(const char *lhs, const char *rhs, size_t n, char a = 'A', char b = 'B', char c = 'C');
+    // Hanoi_restricted_recursive_problem passes all 3^n configurations, the index is read in base 3, n <= 40
+    unsigned long long Hanoi_restricted_index(const char *configuration, size_t n, char from = 'A', char to = 'C', char aux = 'B');
+
+    // Batches: 'amount' configurations of n pegs one after another
+    void Hanoi_classic_indices(const char *configurations, size_t n, size_t amount, unsigned long long *out, char from = 'A', char to = 'C', char aux = 'B');
+    void Hanoi_classic_distances(const char *lhs, const char *rhs, size_t n, size_t amount, unsigned long long *out, char a = 'A', char b = 'B', char c = 'C');
+    void Hanoi_restricted_indices(const char *configurations, size_t n, size_t amount, unsigned long long *out, char from = 'A', char to = 'C', char aux = 'B');
+
     unsigned long long surjective_mappings_inclusion_exclusion(size_t n, size_t m);
     std::string binomial_formula(size_t n);
 
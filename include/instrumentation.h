@@ -0,0 +1,206 @@
+#ifndef __IMD_INSTRUMENTATION_
+#define __IMD_INSTRUMENTATION_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Compile the library with -DIMD_COMBINATORICS_INSTRUMENTATION to enable the counters,
+// otherwise every probe expands to nothing and snapshots contain zeros only
+namespace IMD
+{
+    namespace instrumentation
+    {
+        enum class probe : size_t
+        {
+            Fibonacci_goto_index,
+            Luka_goto_index,
+            linear_recurrence_goto_index,
+            Fibonacci_modulo,
+            Luka_modulo,
+            Catalan_goto_index,
+            Pascal_triangle,
+            Pascal_triangle_row,
+            Pascal_triangle_mod2,
+            Pascal_triangle_mod3,
+            Pascal_binomial_coefficient,
+            iterative_binomial_coefficient,
+            modular_binomial_coefficient,
+            big_factorial,
+            big_multinomial_coefficient,
+            binomial_coefficient_128,
+            factorial_128,
+            surjective_mappings_128,
+            exact_binomial_coefficient,
+            exact_factorial,
+            exact_surjective_mappings,
+            Josephus_recursive_problem,
+            Josephus_iterative_problem,
+            Hanoi_classic_recursive_problem,
+            Hanoi_classic_iterative_problem,
+            Hanoi_restricted_recursive_problem,
+            Hanoi_classic_index,
+            Hanoi_classic_distance,
+            Hanoi_restricted_index,
+            surjective_mappings_inclusion_exclusion,
+            binomial_formula,
+            log_factorial,
+            log_binomial_coefficient,
+            log_multinomial_coefficient,
+            precomputed_table,
+            k_subset,
+            permutation,
+            Dyck_path,
+            surjection,
+
+            amount // Not a probe
+        };
+
+        constexpr size_t probes_amount = static_cast<size_t>(probe::amount);
+
+        const char *probe_name(probe p) noexcept;
+
+        struct function_counters
+        {
+            std::uint64_t calls = 0;           // outermost calls only, recursion is not counted
+            std::uint64_t nanoseconds = 0;     // wall time of the outermost calls
+            std::uint64_t steps = 0;           // previous() steps in goto_index, moves in Hanoi, ...
+            std::uint64_t allocations = 0;
+            std::uint64_t allocated_bytes = 0;
+            std::uint64_t overflows = 0;       // detected overflows of the result
+            std::uint64_t io_nanoseconds = 0;  // time spent writing into std::ostream
+        };
+
+        struct snapshot
+        {
+            std::array<function_counters, probes_amount> functions{};
+
+            const function_counters &operator[](probe p) const noexcept;
+        };
+
+        constexpr bool enabled() noexcept
+        {
+#ifdef IMD_COMBINATORICS_INSTRUMENTATION
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        // Sums the counters of all alive threads and of the finished ones
+        snapshot take_snapshot();
+        // Warning: increments made by other threads at the same moment may survive the reset
+        void reset();
+
+        void dump_json(std::ostream &os, const snapshot &snap);
+        std::string to_json(const snapshot &snap);
+
+        namespace detail
+        {
+            // Every counter is written by its owner thread only, so a relaxed load + store is enough (no lock prefix)
+            struct thread_counters
+            {
+                struct slot
+                {
+                    std::atomic<std::uint64_t> calls{0}, nanoseconds{0}, steps{0}, allocations{0},
+                        allocated_bytes{0}, overflows{0}, io_nanoseconds{0};
+                    unsigned depth = 0;
+                };
+
+                std::array<slot, probes_amount> slots;
+
+                thread_counters();
+                ~thread_counters();
+            };
+
+            thread_counters &local() noexcept;
+
+            inline void bump(std::atomic<std::uint64_t> &counter, std::uint64_t value) noexcept
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+
+            inline thread_counters::slot &slot_of(probe p) noexcept
+            {
+                return local().slots[static_cast<size_t>(p)];
+            }
+
+            inline std::uint64_t now() noexcept
+            {
+                return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                      std::chrono::steady_clock::now().time_since_epoch())
+                                                      .count());
+            }
+
+            class scoped_call
+            {
+            private:
+                thread_counters::slot &__slot;
+                std::uint64_t __start;
+
+            public:
+                explicit scoped_call(probe p) noexcept
+                    : __slot(slot_of(p)), __start(__slot.depth++ == 0 ? now() : 0) {}
+                ~scoped_call()
+                {
+                    if (--this->__slot.depth == 0)
+                    {
+                        bump(this->__slot.calls, 1);
+                        bump(this->__slot.nanoseconds, now() - this->__start);
+                    }
+                }
+
+                scoped_call(const scoped_call &) = delete;
+                scoped_call &operator=(const scoped_call &) = delete;
+            };
+
+            class scoped_io
+            {
+            private:
+                thread_counters::slot &__slot;
+                std::uint64_t __start;
+
+            public:
+                explicit scoped_io(probe p) noexcept
+                    : __slot(slot_of(p)), __start(now()) {}
+                ~scoped_io()
+                {
+                    bump(this->__slot.io_nanoseconds, now() - this->__start);
+                }
+
+                scoped_io(const scoped_io &) = delete;
+                scoped_io &operator=(const scoped_io &) = delete;
+            };
+        }
+    }
+}
+
+#ifdef IMD_COMBINATORICS_INSTRUMENTATION
+#define IMD_PROBE_CALL(p) ::IMD::instrumentation::detail::scoped_call __imd_probe_call(::IMD::instrumentation::probe::p)
+#define IMD_PROBE_IO(p) ::IMD::instrumentation::detail::scoped_io __imd_probe_io(::IMD::instrumentation::probe::p)
+#define IMD_PROBE_STEPS(p, n) ::IMD::instrumentation::detail::bump(::IMD::instrumentation::detail::slot_of(::IMD::instrumentation::probe::p).steps, (n))
+#define IMD_PROBE_ALLOCATION(p, bytes)                                                                                     \
+    do                                                                                                                     \
+    {                                                                                                                      \
+        auto &__imd_slot = ::IMD::instrumentation::detail::slot_of(::IMD::instrumentation::probe::p);                      \
+        ::IMD::instrumentation::detail::bump(__imd_slot.allocations, 1);                                                   \
+        ::IMD::instrumentation::detail::bump(__imd_slot.allocated_bytes, (bytes));                                         \
+    } while (false)
+#define IMD_PROBE_OVERFLOW(p, condition)                                                                                   \
+    do                                                                                                                     \
+    {                                                                                                                      \
+        if (condition)                                                                                                     \
+            ::IMD::instrumentation::detail::bump(::IMD::instrumentation::detail::slot_of(::IMD::instrumentation::probe::p).overflows, 1); \
+    } while (false)
+#else
+#define IMD_PROBE_CALL(p) ((void)0)
+#define IMD_PROBE_IO(p) ((void)0)
+#define IMD_PROBE_STEPS(p, n) ((void)0)
+#define IMD_PROBE_ALLOCATION(p, bytes) ((void)0)
+#define IMD_PROBE_OVERFLOW(p, condition) ((void)0)
+#endif
+
+#endif
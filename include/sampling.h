@@ -0,0 +1,107 @@
+#ifndef __IMD_SAMPLING_
+#define __IMD_SAMPLING_
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+namespace IMD
+{
+    // xoshiro256++ (Blackman, Vigna), satisfies UniformRandomBitGenerator
+    struct xoshiro256_plus_plus
+    {
+    public:
+        using result_type = std::uint64_t;
+
+    private:
+        std::uint64_t __state[4];
+
+    public:
+        // The state is expanded from the seed with splitmix64
+        explicit xoshiro256_plus_plus(std::uint64_t seed = 0) noexcept;
+
+        static constexpr result_type min() noexcept { return 0; }
+        static constexpr result_type max() noexcept { return ~result_type(0); }
+
+        result_type operator()() noexcept;
+
+        // Advances the generator by 2^128 steps: every jump starts a non-overlapping stream
+        void jump() noexcept;
+        // The stream with the number 'index' of the generator seeded with 'seed'
+        static xoshiro256_plus_plus stream(std::uint64_t seed, size_t index) noexcept;
+    };
+
+    // Uniform random combinatorial objects: k-subsets, permutations, Dyck paths and surjections.
+    // Single objects are written into caller buffers, bulk functions write 'amount' objects one after another.
+    // The elements are 32-bit, k-subsets, permutations and surjections of n > 2^32 elements throw
+    struct combinatorial_sampler
+    {
+    public:
+        using element_type = std::uint32_t;
+
+    private:
+        xoshiro256_plus_plus __generator;
+        std::vector<std::uint64_t> __scratch;     // bitmap / hash table of Floyd's algorithm
+        std::vector<double> __Stirling;            // log S(i, j) for the last surjection parameters
+        size_t __Stirling_n, __Stirling_m;
+        std::vector<element_type> __labels;
+        std::vector<unsigned char> __steps;       // arrangement of Dyck_path before the rotation
+
+        void prepare_Stirling(size_t n, size_t m);
+
+    public:
+        explicit combinatorial_sampler(std::uint64_t seed = 0, size_t stream = 0);
+
+        combinatorial_sampler(const combinatorial_sampler &other);
+        combinatorial_sampler(combinatorial_sampler &&other) noexcept;
+
+        combinatorial_sampler &operator=(const combinatorial_sampler &other);
+        combinatorial_sampler &operator=(combinatorial_sampler &&other) noexcept;
+
+        xoshiro256_plus_plus &generator() noexcept;
+
+        // Uniform integer in [0, bound) (Lemire's nearly divisionless method)
+        std::uint64_t bounded(std::uint64_t bound) noexcept;
+
+        // k distinct elements of [0, n) in no particular order (Floyd's algorithm)
+        void k_subset(size_t n, size_t k, element_type *out);
+        // Fisher-Yates shuffle of [0, n), two swaps are drawn from one random word while possible
+        void permutation(size_t n, element_type *out);
+        // 2n steps, 1 is up and 0 is down (a random arrangement of n ups and n + 1 downs rotated by the cycle lemma)
+        void Dyck_path(size_t n, unsigned char *out);
+        // out[i] is the image of i in [0, m), every value is hit (Stirling numbers recursion with a random labelling).
+        // Below n = m (ln m + 2) it keeps a table of (n + 1)(m + 1) doubles, e.g. 40 MB for n = 5000, m = 1000
+        void surjection(size_t n, size_t m, element_type *out);
+
+        void k_subsets(size_t n, size_t k, size_t amount, element_type *out);
+        void permutations(size_t n, size_t amount, element_type *out);
+        void Dyck_paths(size_t n, size_t amount, unsigned char *out);
+        void surjections(size_t n, size_t m, size_t amount, element_type *out);
+    };
+
+    // Splits 'amount' samples of 'sample_size' elements between 'threads' samplers with independent streams of 'seed'.
+    // 'generate(sampler, count, out)' has to write 'count' samples into 'out', e.g. a call of combinatorial_sampler::permutations
+    template <typename T, typename Generate>
+    void parallel_samples(std::uint64_t seed, size_t threads, size_t amount, size_t sample_size, T *out, Generate generate)
+    {
+        threads = std::max<size_t>(1, std::min(threads, amount));
+        const size_t per_thread = amount / threads, rest = amount % threads;
+
+        std::vector<std::thread> pool;
+        size_t first(0);
+        for (size_t i(0); i < threads; ++i)
+        {
+            const size_t count = per_thread + (i < rest ? 1 : 0);
+            pool.emplace_back([=, &generate]
+                              {
+                                  combinatorial_sampler sampler(seed, i);
+                                  generate(sampler, count, out + first * sample_size); });
+            first += count;
+        }
+        for (std::thread &t : pool)
+            t.join();
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef __IMD_TABLES_
+#define __IMD_TABLES_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace IMD
+{
+    // Precomputed table stored in a versioned, checksummed binary file and mapped with mmap,
+    // so the pages are loaded lazily and shared between all processes using the same file.
+    //
+    // File layout (native endianness, 8 bytes aligned):
+    //   header: magic "IMDTABLE", version, kind, modulus, size, payload length, FNV-1a checksum of the payload
+    //   payload: 64-bit elements
+    //     Pascal_triangle   - rows [0, size), row i holds C(i, 0..i)
+    //     factorials        - i! for i in [0, size), then (i!)^(-1) for i in [0, size)
+    //     Catalan_numbers   - C_i for i in [0, size)
+    //     Fibonacci_numbers - F_i for i in [0, size)
+    // The elements are reduced modulo 'modulus', zero modulus means exact values.
+    struct precomputed_table
+    {
+    public:
+        using element_type = std::uint64_t;
+
+        enum class kind : std::uint32_t
+        {
+            Pascal_triangle = 1,
+            factorials = 2,
+            Catalan_numbers = 3,
+            Fibonacci_numbers = 4
+        };
+
+        static constexpr std::uint32_t format_version = 1;
+
+    private:
+        kind __kind;
+        element_type __modulus;
+        std::uint64_t __size;
+
+        const element_type *__data;
+        std::vector<element_type> __storage; // used when the table is computed or can't be mapped
+        void *__mapping;
+        size_t __mapping_length;
+
+        precomputed_table(kind k, element_type modulus, std::uint64_t size);
+
+        void release() noexcept;
+
+    public:
+        precomputed_table(const precomputed_table &other) = delete;
+        precomputed_table(precomputed_table &&other) noexcept;
+        ~precomputed_table();
+
+        precomputed_table &operator=(const precomputed_table &other) = delete;
+        precomputed_table &operator=(precomputed_table &&other) noexcept;
+
+        // Throws std::runtime_error if the file is missing, damaged or doesn't match the parameters.
+        // Verifying the checksum reads the whole payload, so it is optional
+        static precomputed_table open(const std::string &path, kind k, element_type modulus, bool verify_checksum = false);
+        static precomputed_table compute(kind k, std::uint64_t size, element_type modulus);
+        // Maps the file if it is valid and large enough, otherwise computes the table in memory
+        static precomputed_table open_or_compute(const std::string &path, kind k, std::uint64_t size, element_type modulus);
+
+        static void generate(const std::string &path, kind k, std::uint64_t size, element_type modulus);
+
+        kind table_kind() const noexcept;
+        element_type modulus() const noexcept;
+        std::uint64_t size() const noexcept;
+        bool mapped() const noexcept;
+        bool verify() const noexcept;
+
+        const element_type *data() const noexcept;
+        std::uint64_t length() const noexcept; // amount of the payload elements
+
+        // Accessors don't check the kind and the bounds
+        element_type binomial(std::uint64_t k, std::uint64_t n) const noexcept;
+        element_type factorial(std::uint64_t n) const noexcept;
+        element_type inverse_factorial(std::uint64_t n) const noexcept;
+        element_type operator[](std::uint64_t index) const noexcept;
+    };
+}
+
+#endif
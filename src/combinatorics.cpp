@@ -4,7 +4,13 @@
 #include <sstream>
 #include <stack>
 #include <tuple>
+#include <algorithm>
+#include <future>
+#include <functional>
+#include <climits>
+#include <cstring>
 #include "../include/combinatorics.h"
+#include "../include/instrumentation.h"
 
 IMD::arithmetic_progression::arithmetic_progression(element_type start, element_type step)
     : __start(start), __curr(start), __step(step), __curr_index(0) {}
@@ -191,238 +197,350 @@ void IMD::geometric_progression::reset() noexcept
     this->__curr_index = 0;
 }
 
-IMD::Fibonacci_numbers::Fibonacci_numbers(index_type start_index)
-    : __curr_index(0), __curr(0), __next(1)
+namespace
 {
-    this->goto_index(start_index);
-}
+    unsigned long long multiply_high(unsigned long long a, unsigned long long b) noexcept
+    {
+#ifdef __SIZEOF_INT128__
+        return static_cast<unsigned long long>((static_cast<unsigned __int128>(a) * b) >> 64);
+#else
+        const unsigned long long a_lo = a & 0xFFFFFFFFULL, a_hi = a >> 32, b_lo = b & 0xFFFFFFFFULL, b_hi = b >> 32;
+        const unsigned long long lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+        const unsigned long long middle = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+        return hi_hi + (hi_lo >> 32) + (middle >> 32);
+#endif
+    }
 
-IMD::Fibonacci_numbers::Fibonacci_numbers(const Fibonacci_numbers &other)
-    : __curr_index(other.__curr_index), __curr(other.__curr), __next(other.__next) {}
+    // x mod m for x < 2^64, 'reciprocal' is floor((2^64 - 1) / m)
+    unsigned long long Barrett_reduce(unsigned long long x, unsigned long long m, unsigned long long reciprocal) noexcept
+    {
+        x -= multiply_high(x, reciprocal) * m;
+        x = (x >= m) ? x - m : x;
+        return (x >= m) ? x - m : x;
+    }
 
-IMD::Fibonacci_numbers::Fibonacci_numbers(Fibonacci_numbers &&other) noexcept
-    : __curr_index(std::move(other.__curr_index)),
-      __curr(std::move(other.__curr)),
-      __next(std::move(other.__next)) {}
+    // (F(k), F(k + 1)) -> (F(2k + bit), F(2k + bit + 1)) modulo m < 2^32
+    void Fibonacci_doubling_step(unsigned long long &a, unsigned long long &b, bool bit, unsigned long long m, unsigned long long reciprocal) noexcept
+    {
+        unsigned long long t = 2 * b + m - a; // 2F(k + 1) - F(k), below 3m
+        t = (t >= m) ? t - m : t;
+        t = (t >= m) ? t - m : t;
 
-IMD::Fibonacci_numbers &IMD::Fibonacci_numbers::operator=(const Fibonacci_numbers &other)
-{
-    if (this != &other)
+        const unsigned long long c = Barrett_reduce(a * t, m, reciprocal);                                                     // F(2k)
+        unsigned long long d = Barrett_reduce(a * a, m, reciprocal) + Barrett_reduce(b * b, m, reciprocal);                     // F(2k + 1)
+        d = (d >= m) ? d - m : d;
+
+        unsigned long long e = c + d; // F(2k + 2)
+        e = (e >= m) ? e - m : e;
+
+        a = bit ? d : c;
+        b = bit ? e : d;
+    }
+
+    // (F(n), F(n + 1)) modulo m
+    void Fibonacci_pair(unsigned long long n, unsigned long long m, unsigned long long reciprocal, unsigned long long &a, unsigned long long &b) noexcept
     {
-        this->__curr_index = other.__curr_index;
-        this->__curr = other.__curr;
-        this->__next = other.__next;
+        a = 0;
+        b = 1 % m;
+
+        size_t bits(0);
+        while ((n >> bits) != 0)
+            ++bits;
+        for (; bits > 0; --bits)
+            Fibonacci_doubling_step(a, b, (n >> (bits - 1)) & 1, m, reciprocal);
+    }
+
+    std::vector<std::pair<unsigned long long, size_t>> factorize(unsigned long long num)
+    {
+        std::vector<std::pair<unsigned long long, size_t>> res;
+        for (unsigned long long d(2); d * d <= num; ++d)
+        {
+            if (num % d != 0)
+                continue;
+
+            size_t exponent(0);
+            while (num % d == 0)
+            {
+                num /= d;
+                ++exponent;
+            }
+            res.emplace_back(d, exponent);
+        }
+        if (num > 1)
+            res.emplace_back(num, 1);
+        return res;
+    }
+
+    unsigned long long Pisano_period_of_prime(unsigned long long p)
+    {
+        if (p == 2)
+            return 3;
+        if (p == 5)
+            return 20;
+
+        const unsigned long long reciprocal = ~0ULL / p;
+        auto is_period = [&](unsigned long long k) noexcept
+        {
+            unsigned long long a, b;
+            Fibonacci_pair(k, p, reciprocal, a, b);
+            return a == 0 && b == 1;
+        };
+
+        // The period divides p - 1 if p = +-1 (mod 10) and 2(p + 1) if p = +-3 (mod 10)
+        unsigned long long res = (p % 10 == 1 || p % 10 == 9) ? p - 1 : 2 * (p + 1);
+        for (const auto &[q, exponent] : factorize(res))
+            for (size_t i(0); i < exponent && is_period(res / q); ++i)
+                res /= q;
+        return res;
+    }
+
+    unsigned long long gcd(unsigned long long a, unsigned long long b) noexcept
+    {
+        while (b != 0)
+            std::tie(a, b) = std::make_tuple(b, a % b);
+        return a;
     }
-    return *this;
 }
 
-IMD::Fibonacci_numbers &IMD::Fibonacci_numbers::operator=(Fibonacci_numbers &&other) noexcept
+IMD::Fibonacci_modulo_solver::Fibonacci_modulo_solver(const Fibonacci_modulo_solver &other)
+    : __contexts(other.__contexts) {}
+
+IMD::Fibonacci_modulo_solver::Fibonacci_modulo_solver(Fibonacci_modulo_solver &&other) noexcept
+    : __contexts(std::move(other.__contexts)) {}
+
+IMD::Fibonacci_modulo_solver &IMD::Fibonacci_modulo_solver::operator=(const Fibonacci_modulo_solver &other)
 {
-    this->__curr_index = std::move(other.__curr_index);
-    this->__curr = std::move(other.__curr);
-    this->__next = std::move(other.__next);
+    if (this != &other)
+        this->__contexts = other.__contexts;
     return *this;
 }
 
-bool IMD::Fibonacci_numbers::operator==(const Fibonacci_numbers &other)
-{
-    return this->__curr_index == other.__curr_index;
-}
-bool IMD::Fibonacci_numbers::operator!=(const Fibonacci_numbers &other)
+IMD::Fibonacci_modulo_solver &IMD::Fibonacci_modulo_solver::operator=(Fibonacci_modulo_solver &&other) noexcept
 {
-    return !this->operator==(other);
+    this->__contexts = std::move(other.__contexts);
+    return *this;
 }
 
-IMD::Fibonacci_numbers::element_type IMD::Fibonacci_numbers::current() const noexcept
+const IMD::Fibonacci_modulo_solver::modulus_context &IMD::Fibonacci_modulo_solver::context(element_type modulus)
 {
-    return this->__curr;
+    auto it = this->__contexts.find(modulus);
+    if (it != this->__contexts.end())
+        return it->second;
+
+    if (modulus == 0)
+        throw std::invalid_argument("The argument 'modulus' is zero");
+    if (modulus > 0xFFFFFFFFULL)
+        throw std::invalid_argument("The argument 'modulus' is more than 2^32");
+
+    // pi(m) = lcm(pi(p^e)), pi(p^e) = p^(e - 1) * pi(p) (Wall's conjecture, verified far beyond 2^32)
+    index_type period(1);
+    for (const auto &[p, exponent] : factorize(modulus))
+    {
+        index_type prime_power_period = Pisano_period_of_prime(p);
+        for (size_t i(1); i < exponent; ++i)
+            prime_power_period *= p;
+        period = period / gcd(period, prime_power_period) * prime_power_period;
+    }
+
+    // Newton's iteration doubles the correct low bits of the inverse: 3 -> 6 -> 12 -> 24 -> 48
+    element_type inverse(0);
+    if (modulus & 1)
+    {
+        std::uint32_t x = static_cast<std::uint32_t>(modulus);
+        for (size_t i(0); i < 4; ++i)
+            x *= 2 - static_cast<std::uint32_t>(modulus) * x;
+        inverse = static_cast<std::uint32_t>(0 - x);
+    }
+
+    return this->__contexts
+        .emplace(modulus, modulus_context{modulus, ~element_type(0) / modulus, period, inverse, (1ULL << 32) % modulus})
+        .first->second;
 }
-void IMD::Fibonacci_numbers::next() noexcept
+
+IMD::Fibonacci_modulo_solver::index_type IMD::Fibonacci_modulo_solver::Pisano_period(element_type modulus)
 {
-    element_type tmp = this->__next;
-    this->__next += this->__curr;
-    this->__curr = tmp;
-    ++this->__curr_index;
+    return this->context(modulus).period;
 }
-void IMD::Fibonacci_numbers::previous() noexcept
+
+IMD::Fibonacci_modulo_solver::element_type IMD::Fibonacci_modulo_solver::Fibonacci(index_type n, element_type modulus)
 {
-    if (this->__curr_index == 0)
-        return;
+    IMD_PROBE_CALL(Fibonacci_modulo);
 
-    element_type tmp = this->__next - this->__curr;
-    this->__next = this->__curr;
-    this->__curr = tmp;
-    --this->__curr_index;
+    const modulus_context &ctx = this->context(modulus);
+
+    element_type a, b;
+    Fibonacci_pair(n % ctx.period, ctx.modulus, ctx.reciprocal, a, b);
+    return a;
 }
-IMD::Fibonacci_numbers::index_type IMD::Fibonacci_numbers::index() const noexcept
+
+IMD::Fibonacci_modulo_solver::element_type IMD::Fibonacci_modulo_solver::Luka(index_type n, element_type modulus)
 {
-    return this->__curr_index;
+    IMD_PROBE_CALL(Luka_modulo);
+
+    const modulus_context &ctx = this->context(modulus);
+
+    // L(n) = 2F(n + 1) - F(n)
+    element_type a, b;
+    Fibonacci_pair(n % ctx.period, ctx.modulus, ctx.reciprocal, a, b);
+    return (2 * b + ctx.modulus - a) % ctx.modulus;
 }
 
-void IMD::Fibonacci_numbers::goto_index(index_type index) noexcept
+namespace
 {
-    if (index == this->__curr_index)
-        return;
+    // x * 2^-32 mod m for an odd m < 2^31 and x < m * 2^32, 'inverse' is -m^-1 mod 2^32. The products are 32 x 32 -> 64 bits,
+    // which vector units multiply without the 128-bit product of Barrett_reduce
+    inline std::uint32_t Montgomery_reduce(std::uint64_t x, std::uint32_t m, std::uint32_t inverse) noexcept
+    {
+        const std::uint32_t low = static_cast<std::uint32_t>(x);
+        const std::uint32_t u = low * inverse;
+        // x + u * m is divisible by 2^32: its low halves carry exactly when 'low' isn't zero
+        const std::uint32_t t = static_cast<std::uint32_t>(x >> 32) + static_cast<std::uint32_t>((std::uint64_t(u) * m) >> 32) + (low != 0 ? 1 : 0);
+        return (t >= m) ? t - m : t;
+    }
 
-    if (index < this->__curr_index)
+    // Fibonacci_doubling_step on values in Montgomery form (x * 2^32 mod m), every sum stays below 2m < 2^32
+    inline void Fibonacci_Montgomery_step(std::uint32_t &a, std::uint32_t &b, std::uint32_t bit, std::uint32_t m, std::uint32_t inverse) noexcept
     {
-        const index_type steps_backward = this->__curr_index - index;
-        const index_type reset_threshold = this->__curr_index / 2;
+        std::uint32_t t = 2 * b;
+        t = (t >= m) ? t - m : t;
+        t += m - a;
+        t = (t >= m) ? t - m : t;
 
-        if (steps_backward > reset_threshold)
-            this->reset();
-        else
-        {
-            while (this->__curr_index > index)
-                this->previous();
-            return;
-        }
-    }
+        const std::uint32_t c = Montgomery_reduce(std::uint64_t(a) * t, m, inverse);
+        std::uint32_t d = Montgomery_reduce(std::uint64_t(a) * a, m, inverse) + Montgomery_reduce(std::uint64_t(b) * b, m, inverse);
+        d = (d >= m) ? d - m : d;
+
+        std::uint32_t e = c + d;
+        e = (e >= m) ? e - m : e;
 
-    index_type remaining_steps = index - this->__curr_index;
-    const index_type double_step_threshold = 2;
+        a = bit ? d : c;
+        b = bit ? e : d;
+    }
 
-    while (remaining_steps > 0)
+    // Queries with odd moduli below 2^31 are gathered into 'batch_lanes' lanes of 32 bits and doubled in lockstep: the lane
+    // loop is branch free and vectorized by the compiler (e.g. GCC -O3 with AVX2). Other moduli take the scalar Barrett path.
+    // 'context_of(modulus)' returns the modulus_context of the solver
+    template <bool Luka, typename Context_of>
+    void Fibonacci_batch(const unsigned long long *indices, const unsigned long long *moduli, unsigned long long *out, size_t amount,
+                         Context_of context_of)
     {
-        if (remaining_steps >= double_step_threshold)
+        constexpr size_t lanes = IMD::Fibonacci_modulo_solver::batch_lanes;
+
+        unsigned long long k[lanes];
+        std::uint32_t m[lanes], inverse[lanes], a[lanes], b[lanes];
+        size_t slots[lanes];
+        size_t active(0);
+
+        const auto run_lanes = [&]
         {
-            // Double step: advance two positions in one operation
-            element_type tmp1 = this->__curr + this->__next;
-            element_type tmp2 = this->__next + tmp1;
-            this->__curr = tmp1;
-            this->__next = tmp2;
-            this->__curr_index += 2;
-            remaining_steps -= 2;
-        }
-        else
+            // Unused lanes compute F(0) modulo 1
+            for (size_t i(active); i < lanes; ++i)
+                k[i] = 0, m[i] = 1, inverse[i] = 0xFFFFFFFF, a[i] = 0, b[i] = 0;
+
+            unsigned long long all_bits(0);
+            for (size_t i(0); i < lanes; ++i)
+                all_bits |= k[i];
+
+            // Leading zero bits keep (F(0), F(1)) unchanged, so all lanes start from the highest bit
+            size_t bits(0);
+            while ((all_bits >> bits) != 0)
+                ++bits;
+            // The indices are walked in words of 32 bits, which keeps every lane of the loop 32 bits wide
+            std::uint32_t word[lanes];
+            while (bits > 0)
+            {
+                const size_t low = (bits > 32) ? 32 : 0;
+                for (size_t i(0); i < lanes; ++i)
+                    word[i] = static_cast<std::uint32_t>(k[i] >> low);
+                for (; bits > low; --bits)
+                    for (size_t i(0); i < lanes; ++i)
+                        Fibonacci_Montgomery_step(a[i], b[i], (word[i] >> (bits - low - 1)) & 1, m[i], inverse[i]);
+            }
+
+            for (size_t i(0); i < active; ++i)
+            {
+                const unsigned long long f = Montgomery_reduce(a[i], m[i], inverse[i]), g = Montgomery_reduce(b[i], m[i], inverse[i]);
+                out[slots[i]] = Luka ? (2 * g + m[i] - f) % m[i] : f;
+            }
+            active = 0;
+        };
+
+        for (size_t q(0); q < amount; ++q)
         {
-            this->next();
-            --remaining_steps;
+            const auto &ctx = context_of(moduli[q]);
+            const unsigned long long n = indices[q] % ctx.period;
+            if ((ctx.modulus & 1) == 0 || ctx.modulus >= (1ULL << 31))
+            {
+                unsigned long long f, g;
+                Fibonacci_pair(n, ctx.modulus, ctx.reciprocal, f, g);
+                out[q] = Luka ? (2 * g + ctx.modulus - f) % ctx.modulus : f;
+                continue;
+            }
+
+            k[active] = n;
+            m[active] = static_cast<std::uint32_t>(ctx.modulus);
+            inverse[active] = static_cast<std::uint32_t>(ctx.Montgomery_inverse);
+            a[active] = 0;
+            b[active] = static_cast<std::uint32_t>(ctx.Montgomery_one);
+            slots[active] = q;
+            if (++active == lanes)
+                run_lanes();
         }
+        if (active > 0)
+            run_lanes();
     }
 }
 
-void IMD::Fibonacci_numbers::reset() noexcept
+void IMD::Fibonacci_modulo_solver::Fibonacci(const index_type *indices, const element_type *moduli, element_type *out, size_t amount)
 {
-    this->__curr = 0;
-    this->__next = 1;
-    this->__curr_index = 0;
-}
+    IMD_PROBE_CALL(Fibonacci_modulo);
 
-IMD::Luka_numbers::Luka_numbers(index_type start_index)
-    : __curr_index(0), __curr(2), __next(1)
-{
-    this->goto_index(start_index);
+    const modulus_context *last = nullptr;
+    Fibonacci_batch<false>(indices, moduli, out, amount, [&](element_type modulus) -> const modulus_context &
+                           {
+                               if (last == nullptr || last->modulus != modulus)
+                                   last = &this->context(modulus);
+                               return *last; });
 }
 
-IMD::Luka_numbers::Luka_numbers(const Luka_numbers &other)
-    : __curr_index(other.__curr_index), __curr(other.__curr), __next(other.__next) {}
-
-IMD::Luka_numbers::Luka_numbers(Luka_numbers &&other) noexcept
-    : __curr_index(std::move(other.__curr_index)),
-      __curr(std::move(other.__curr)),
-      __next(std::move(other.__next)) {}
-
-IMD::Luka_numbers &IMD::Luka_numbers::operator=(const Luka_numbers &other)
+void IMD::Fibonacci_modulo_solver::Luka(const index_type *indices, const element_type *moduli, element_type *out, size_t amount)
 {
-    if (this != &other)
-    {
-        this->__curr_index = other.__curr_index;
-        this->__curr = other.__curr;
-        this->__next = other.__next;
-    }
-    return *this;
-}
+    IMD_PROBE_CALL(Luka_modulo);
 
-IMD::Luka_numbers &IMD::Luka_numbers::operator=(Luka_numbers &&other) noexcept
-{
-    this->__curr_index = std::move(other.__curr_index);
-    this->__curr = std::move(other.__curr);
-    this->__next = std::move(other.__next);
-    return *this;
-}
-bool IMD::Luka_numbers::operator==(const Luka_numbers &other)
-{
-    return this->__curr_index == other.__curr_index;
-}
-bool IMD::Luka_numbers::operator!=(const Luka_numbers &other)
-{
-    return !this->operator==(other);
+    const modulus_context *last = nullptr;
+    Fibonacci_batch<true>(indices, moduli, out, amount, [&](element_type modulus) -> const modulus_context &
+                          {
+                              if (last == nullptr || last->modulus != modulus)
+                                  last = &this->context(modulus);
+                              return *last; });
 }
 
-IMD::Luka_numbers::element_type IMD::Luka_numbers::current() const noexcept
-{
-    return this->__curr;
-}
-void IMD::Luka_numbers::next() noexcept
-{
-    element_type tmp = this->__next;
-    this->__next += this->__curr;
-    this->__curr = tmp;
-    ++this->__curr_index;
-}
-void IMD::Luka_numbers::previous() noexcept
+size_t IMD::Fibonacci_modulo_solver::cached_moduli() const noexcept
 {
-    if (this->__curr_index == 0)
-        return;
-    element_type tmp = this->__next - this->__curr;
-    this->__next = this->__curr;
-    this->__curr = tmp;
-    --this->__curr_index;
+    return this->__contexts.size();
 }
-IMD::Luka_numbers::index_type IMD::Luka_numbers::index() const noexcept
+
+void IMD::Fibonacci_modulo_solver::clear() noexcept
 {
-    return this->__curr_index;
+    this->__contexts.clear();
 }
 
-void IMD::Luka_numbers::goto_index(index_type index) noexcept
+namespace
 {
-    if (index == this->__curr_index)
-        return;
-
-    if (index < this->__curr_index)
-    {
-        const index_type steps_backward = this->__curr_index - index;
-        const index_type reset_threshold = this->__curr_index / 2;
-
-        if (steps_backward > reset_threshold)
-            this->reset();
-        else
-        {
-            while (this->__curr_index > index)
-                this->previous();
-            return;
-        }
-    }
-
-    index_type remaining_steps = index - this->__curr_index;
-    index_type double_step_threshold = 2;
-
-    while (remaining_steps > 0)
+    IMD::Fibonacci_modulo_solver &thread_Fibonacci_modulo_solver()
     {
-        if (remaining_steps >= double_step_threshold)
-        {
-            // Double step: advance two positions in one operation
-            element_type tmp1 = this->__curr + this->__next;
-            element_type tmp2 = this->__next + tmp1;
-            this->__curr = tmp1;
-            this->__next = tmp2;
-            this->__curr_index += 2;
-            remaining_steps -= 2;
-        }
-        else
-        {
-            this->next();
-            --remaining_steps;
-        }
+        thread_local IMD::Fibonacci_modulo_solver solver;
+        return solver;
     }
 }
 
-void IMD::Luka_numbers::reset() noexcept
+unsigned long long IMD::Fibonacci_modulo(unsigned long long n, unsigned long long modulus)
 {
-    this->__curr = 2;
-    this->__next = 1;
-    this->__curr_index = 0;
+    return thread_Fibonacci_modulo_solver().Fibonacci(n, modulus);
+}
+unsigned long long IMD::Luka_modulo(unsigned long long n, unsigned long long modulus)
+{
+    return thread_Fibonacci_modulo_solver().Luka(n, modulus);
 }
 
 IMD::Catalan_numbers::Catalan_numbers(index_type start_index)
@@ -491,6 +609,8 @@ void IMD::Catalan_numbers::previous() noexcept
 
 void IMD::Catalan_numbers::goto_index(index_type target_index) noexcept
 {
+    IMD_PROBE_CALL(Catalan_goto_index);
+
     if (target_index == this->__curr_index)
         return;
 
@@ -503,6 +623,7 @@ void IMD::Catalan_numbers::goto_index(index_type target_index) noexcept
             this->reset();
         else
         {
+            IMD_PROBE_STEPS(Catalan_goto_index, steps_backward);
             while (this->__curr_index > target_index)
                 this->previous();
             return;
@@ -510,7 +631,10 @@ void IMD::Catalan_numbers::goto_index(index_type target_index) noexcept
     }
 
     while (this->__curr_index < target_index)
+    {
+        IMD_PROBE_OVERFLOW(Catalan_goto_index, this->__curr > LLONG_MAX / (2 * (2 * (element_type)this->__curr_index + 1)));
         this->next();
+    }
 }
 
 void IMD::Catalan_numbers::reset() noexcept
@@ -522,10 +646,15 @@ void IMD::Catalan_numbers::reset() noexcept
 // Warning: if the methods is called, then dinamic memory will be allocated - don't forget to free it
 unsigned long long **IMD::Pascal_triangle(size_t rows_amount)
 {
-    size_t **res = new size_t *[rows_amount];
+    IMD_PROBE_CALL(Pascal_triangle);
+    IMD_PROBE_ALLOCATION(Pascal_triangle, rows_amount * sizeof(unsigned long long *));
+    IMD_PROBE_OVERFLOW(Pascal_triangle, rows_amount > 68); // C(67, 33) is the last row fitting into 64 bits
+
+    unsigned long long **res = new unsigned long long *[rows_amount];
     for (size_t i(0); i < rows_amount; ++i)
     {
-        res[i] = new size_t[i + 1];
+        IMD_PROBE_ALLOCATION(Pascal_triangle, (i + 1) * sizeof(unsigned long long));
+        res[i] = new unsigned long long[i + 1];
 
         // Borders
         res[i][0] = res[i][i] = 1;
@@ -539,21 +668,63 @@ unsigned long long **IMD::Pascal_triangle(size_t rows_amount)
 // Warning: if the methods is called, then dinamic memory will be allocated - don't forget to free it
 unsigned long long *IMD::Pascal_triangle_row(size_t row_index)
 {
-    size_t *res = new size_t[row_index + 1];
-    res[0] = (1);
+    IMD_PROBE_CALL(Pascal_triangle_row);
+    IMD_PROBE_ALLOCATION(Pascal_triangle_row, (row_index + 1) * sizeof(unsigned long long));
+
+    unsigned long long *res = new unsigned long long[row_index + 1];
+    IMD::Pascal_triangle_row(row_index, res, row_index + 1);
+    return res;
+}
+void IMD::Pascal_triangle_row(size_t row_index, unsigned long long *out, size_t capacity)
+{
+    IMD_PROBE_CALL(Pascal_triangle_row);
+    IMD_PROBE_OVERFLOW(Pascal_triangle_row, row_index > 67);
 
+    if (capacity <= row_index)
+        throw std::invalid_argument("The argument 'capacity' is less than 'row_index' + 1");
+
+    out[0] = (1);
     for (size_t i(1); i <= row_index; ++i)
     {
-        res[i] = (1);
+        out[i] = (1);
         for (size_t j(i - 1); j > 0; --j)
-            res[j] = res[j] + res[j - 1];
+            out[j] = out[j] + out[j - 1];
     }
+}
+#ifdef __cpp_lib_span
+void IMD::Pascal_triangle_row(size_t row_index, std::span<unsigned long long> out)
+{
+    IMD::Pascal_triangle_row(row_index, out.data(), out.size());
+}
+#endif
+
+std::pmr::vector<std::pmr::vector<unsigned long long>> IMD::Pascal_triangle(size_t rows_amount, std::pmr::memory_resource *resource)
+{
+    IMD_PROBE_CALL(Pascal_triangle);
+    IMD_PROBE_OVERFLOW(Pascal_triangle, rows_amount > 68);
 
+    // The rows get the allocator of the outer vector (uses-allocator construction)
+    std::pmr::vector<std::pmr::vector<unsigned long long>> res(resource);
+    res.reserve(rows_amount);
+    for (size_t i(0); i < rows_amount; ++i)
+    {
+        res.emplace_back(i + 1, 1ULL);
+        for (size_t j = 1; j < i; ++j)
+            res[i][j] = res[i - 1][j - 1] + res[i - 1][j];
+    }
+    return res;
+}
+std::pmr::vector<unsigned long long> IMD::Pascal_triangle_row(size_t row_index, std::pmr::memory_resource *resource)
+{
+    std::pmr::vector<unsigned long long> res(row_index + 1, resource);
+    IMD::Pascal_triangle_row(row_index, res.data(), res.size());
     return res;
 }
 
 unsigned long long IMD::Pascal_binomial_coefficient(size_t k, size_t n)
 {
+    IMD_PROBE_CALL(Pascal_binomial_coefficient);
+
     if (k > n)
         throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
     if (k == 0 || k == n)
@@ -563,13 +734,69 @@ unsigned long long IMD::Pascal_binomial_coefficient(size_t k, size_t n)
     if (k > n - k) // Optimization
         k = n - k;
 
-    size_t *tmp = IMD::Pascal_triangle_row(n);
-    size_t res = tmp[k];
-    delete[] tmp;
-    return res;
+    // Only the first k + 1 elements of every row are needed. C(n, k) overflows for k > 33 anyway,
+    // so the stack buffer covers every exact result and the larger k reuse the thread scratch buffer
+    constexpr size_t stack_capacity = 34;
+    unsigned long long stack_buffer[stack_capacity];
+    thread_local std::vector<unsigned long long> scratch;
+
+    unsigned long long *row = stack_buffer;
+    if (k >= stack_capacity)
+    {
+        if (scratch.size() <= k)
+        {
+            IMD_PROBE_ALLOCATION(Pascal_binomial_coefficient, (k + 1) * sizeof(unsigned long long));
+            scratch.resize(k + 1);
+        }
+        row = scratch.data();
+    }
+
+    // Rows [0, k] grow to their full length, the next ones are cut at the element k
+    row[0] = 1;
+    for (size_t i(1); i <= k; ++i)
+    {
+        row[i] = 1;
+        for (size_t j(i - 1); j > 0; --j)
+            row[j] += row[j - 1];
+    }
+    for (size_t i(k + 1); i <= n; ++i)
+        for (size_t j(k); j > 0; --j)
+            row[j] += row[j - 1];
+    return row[k];
+}
+
+namespace
+{
+    // res = C(n - k + i, i) is built as C(n - k + i - 1, i - 1) * (n - k + i) / i while the product fits, otherwise as
+    // C(n - k + i - 1, i - 1) / g * ((n - k + i) / (i / g)) with g = gcd(res, i): then every intermediate value is
+    // a binomial coefficient not above the result, so 'overflow' is exact
+    template <typename T>
+    T reduced_binomial(size_t k, size_t n, bool &overflow) noexcept
+    {
+        T res(1);
+        for (size_t i(1); i <= k; ++i)
+        {
+            if (res <= ~T(0) / (n - k + i))
+            {
+                res = res * (n - k + i) / i;
+                continue;
+            }
+
+            const unsigned long long g = gcd(static_cast<unsigned long long>(res % i), i);
+            const T factor = (n - k + i) / (i / g);
+            res /= g;
+            if (res > ~T(0) / factor)
+                overflow = true;
+            res *= factor;
+        }
+        return res;
+    }
 }
+
 unsigned long long IMD::iterative_binomial_coefficient(size_t k, size_t n)
 {
+    IMD_PROBE_CALL(iterative_binomial_coefficient);
+
     if (k > n)
         throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
     if (k == 0 || k == n)
@@ -579,98 +806,1883 @@ unsigned long long IMD::iterative_binomial_coefficient(size_t k, size_t n)
     if (k > n - k) // Optimization
         k = n - k;
 
-    size_t res(1);
-    for (size_t i(1); i <= k; ++i)
-    {
-        res *= (n - k + i);
-        res /= i;
-    }
-    return res;
-}
-
-size_t IMD::Josephus_recursive_problem(size_t k, size_t n)
-{
-    if (n == 1)
-        return 0;
-    return (Josephus_recursive_problem(k, n - 1) + k) % n;
-}
-size_t IMD::Josephus_iterative_problem(size_t k, size_t n)
-{
-    size_t res(0);
-    for (size_t i(2); i <= n; ++i)
-        res = (res + k) % i;
+    bool overflow(false);
+    const unsigned long long res = reduced_binomial<unsigned long long>(k, n, overflow);
+    IMD_PROBE_OVERFLOW(iterative_binomial_coefficient, overflow);
     return res;
 }
 
-void IMD::Hanoi_classic_recursive_problem(size_t n, char from, char to, char aux, int &moves, std::ostream &os, const char *sep)
+namespace
 {
-    if (n == 0)
-        return;
+    constexpr std::uint64_t low_bits_mask = 0x5555555555555555ULL;
 
-    if (n == 1)
+    // Adds 32 cells of two bits (0, 1 or 2) modulo 3 at once
+    std::uint64_t add_mod3_cells(std::uint64_t a, std::uint64_t b) noexcept
     {
-        os << "Move the " << n << " disk from " << from << " to " << to << sep;
-        ++moves;
-        return;
+        const std::uint64_t a0 = a & low_bits_mask, a1 = (a >> 1) & low_bits_mask;
+        const std::uint64_t b0 = b & low_bits_mask, b1 = (b >> 1) & low_bits_mask;
+        const std::uint64_t a_zero = ~(a0 | a1) & low_bits_mask, b_zero = ~(b0 | b1) & low_bits_mask;
+
+        const std::uint64_t r0 = (a_zero & b0) | (a0 & b_zero) | (a1 & b1); // 0 + 1, 1 + 0, 2 + 2
+        const std::uint64_t r1 = (a_zero & b1) | (a0 & b0) | (a1 & b_zero); // 0 + 2, 1 + 1, 2 + 0
+        return r0 | (r1 << 1);
     }
-    Hanoi_classic_recursive_problem(n - 1, from, aux, to, moves, os, sep);
-    os << "Move the " << n << " disk from " << from << " to " << to << sep;
-    ++moves;
-    Hanoi_classic_recursive_problem(n - 1, aux, to, from, moves, os, sep);
 }
-void IMD::Hanoi_classic_iterative_problem(size_t n, char from, char to, char aux, int &moves, std::ostream &os, const char *sep)
+
+IMD::Pascal_row_mod2::Pascal_row_mod2(index_type start_index)
+    : __curr_index(0), __words(1, 1)
 {
-    if (n == 0)
-        return;
+    this->goto_index(start_index);
+}
 
-    std::stack<std::tuple<int, char, char, char>> st; // n, from, to, aux
-    st.emplace(n, from, to, aux);
+IMD::Pascal_row_mod2::Pascal_row_mod2(const Pascal_row_mod2 &other)
+    : __curr_index(other.__curr_index), __words(other.__words) {}
 
-    while (!st.empty())
-    {
-        auto [curr_n, curr_from, curr_to, curr_aux] = st.top();
-        st.pop();
+IMD::Pascal_row_mod2::Pascal_row_mod2(Pascal_row_mod2 &&other) noexcept
+    : __curr_index(std::move(other.__curr_index)), __words(std::move(other.__words)) {}
 
-        if (curr_n == 1)
-        {
-            os << "Move the " << curr_n << " disk from " << curr_from << " to " << curr_to << sep;
-            ++moves;
-        }
-        else
-        {
-            st.emplace(curr_n - 1, curr_aux, curr_to, curr_from);
-            st.emplace(1, curr_from, curr_to, curr_aux);
-            st.emplace(curr_n - 1, curr_from, curr_aux, curr_to);
-        }
-    }
-}
-void IMD::Hanoi_restricted_recursive_problem(size_t n, char from, char to, char aux, int &moves, std::ostream &os, const char *sep)
+IMD::Pascal_row_mod2 &IMD::Pascal_row_mod2::operator=(const Pascal_row_mod2 &other)
 {
-    if (n == 0)
-        return;
-
-    if (n == 1)
+    if (this != &other)
     {
-        os << "Move the " << n << " disk from " << from << " to " << aux << sep;
-        os << "Move the " << n << " disk from " << aux << " to " << to << sep;
-        moves += 2;
-        return;
+        this->__curr_index = other.__curr_index;
+        this->__words = other.__words;
     }
+    return *this;
+}
 
-    Hanoi_restricted_recursive_problem(n - 1, from, to, aux, moves, os, sep);
-    os << "Move the " << n << " disk from " << from << " to " << aux << sep;
-    ++moves;
-    Hanoi_restricted_recursive_problem(n - 1, to, from, aux, moves, os, sep);
-    os << "Move the " << n << " disk from " << aux << " to " << to << sep;
-    ++moves;
-    Hanoi_restricted_recursive_problem(n - 1, from, to, aux, moves, os, sep);
+IMD::Pascal_row_mod2 &IMD::Pascal_row_mod2::operator=(Pascal_row_mod2 &&other) noexcept
+{
+    this->__curr_index = std::move(other.__curr_index);
+    this->__words = std::move(other.__words);
+    return *this;
 }
-unsigned long long IMD::surjective_mappings_inclusion_exclusion(size_t n, size_t m)
+
+bool IMD::Pascal_row_mod2::operator==(const Pascal_row_mod2 &other)
 {
+    return this->__curr_index == other.__curr_index;
+}
+bool IMD::Pascal_row_mod2::operator!=(const Pascal_row_mod2 &other)
+{
+    return !this->operator==(other);
+}
+
+IMD::Pascal_row_mod2::index_type IMD::Pascal_row_mod2::index() const noexcept
+{
+    return this->__curr_index;
+}
+unsigned IMD::Pascal_row_mod2::operator[](index_type k) const noexcept
+{
+    if (k > this->__curr_index)
+        return 0;
+    return (this->__words[k / cells_per_word] >> (k % cells_per_word)) & 1;
+}
+const std::vector<IMD::Pascal_row_mod2::word_type> &IMD::Pascal_row_mod2::words() const noexcept
+{
+    return this->__words;
+}
+size_t IMD::Pascal_row_mod2::odd_amount() const noexcept
+{
+    size_t bits(0);
+    for (index_type n(this->__curr_index); n != 0; n &= n - 1)
+        ++bits;
+    return size_t(1) << bits;
+}
+
+void IMD::Pascal_row_mod2::next()
+{
+    ++this->__curr_index;
+    if (this->__curr_index / cells_per_word >= this->__words.size())
+        this->__words.push_back(0);
+
+    // From the high words to the low ones, so every word still sees the old value of its predecessor.
+    // The loop has no other dependencies and is vectorized by the compiler
+    word_type *w = this->__words.data();
+    for (size_t i(this->__words.size() - 1); i > 0; --i)
+        w[i] ^= (w[i] << 1) | (w[i - 1] >> (cells_per_word - 1));
+    w[0] ^= w[0] << 1;
+}
+
+void IMD::Pascal_row_mod2::goto_index(index_type index)
+{
+    if (index == this->__curr_index)
+        return;
+    if (index == this->__curr_index + 1)
+    {
+        this->next();
+        return;
+    }
+
+    // C(n, k) is odd iff k is a submask of n
+    this->__curr_index = index;
+    this->__words.assign(index / cells_per_word + 1, 0);
+    for (index_type k(index);; k = (k - 1) & index)
+    {
+        this->__words[k / cells_per_word] |= word_type(1) << (k % cells_per_word);
+        if (k == 0)
+            break;
+    }
+}
+
+void IMD::Pascal_row_mod2::reset()
+{
+    this->__curr_index = 0;
+    this->__words.assign(1, 1);
+}
+
+IMD::Pascal_row_mod3::Pascal_row_mod3(index_type start_index)
+    : __curr_index(0), __words(1, 1)
+{
+    this->goto_index(start_index);
+}
+
+IMD::Pascal_row_mod3::Pascal_row_mod3(const Pascal_row_mod3 &other)
+    : __curr_index(other.__curr_index), __words(other.__words) {}
+
+IMD::Pascal_row_mod3::Pascal_row_mod3(Pascal_row_mod3 &&other) noexcept
+    : __curr_index(std::move(other.__curr_index)), __words(std::move(other.__words)) {}
+
+IMD::Pascal_row_mod3 &IMD::Pascal_row_mod3::operator=(const Pascal_row_mod3 &other)
+{
+    if (this != &other)
+    {
+        this->__curr_index = other.__curr_index;
+        this->__words = other.__words;
+    }
+    return *this;
+}
+
+IMD::Pascal_row_mod3 &IMD::Pascal_row_mod3::operator=(Pascal_row_mod3 &&other) noexcept
+{
+    this->__curr_index = std::move(other.__curr_index);
+    this->__words = std::move(other.__words);
+    return *this;
+}
+
+bool IMD::Pascal_row_mod3::operator==(const Pascal_row_mod3 &other)
+{
+    return this->__curr_index == other.__curr_index;
+}
+bool IMD::Pascal_row_mod3::operator!=(const Pascal_row_mod3 &other)
+{
+    return !this->operator==(other);
+}
+
+IMD::Pascal_row_mod3::index_type IMD::Pascal_row_mod3::index() const noexcept
+{
+    return this->__curr_index;
+}
+unsigned IMD::Pascal_row_mod3::operator[](index_type k) const noexcept
+{
+    if (k > this->__curr_index)
+        return 0;
+    return (this->__words[k / cells_per_word] >> (2 * (k % cells_per_word))) & 3;
+}
+const std::vector<IMD::Pascal_row_mod3::word_type> &IMD::Pascal_row_mod3::words() const noexcept
+{
+    return this->__words;
+}
+
+void IMD::Pascal_row_mod3::next()
+{
+    ++this->__curr_index;
+    if (this->__curr_index / cells_per_word >= this->__words.size())
+        this->__words.push_back(0);
+
+    word_type *w = this->__words.data();
+    for (size_t i(this->__words.size() - 1); i > 0; --i)
+        w[i] = add_mod3_cells(w[i], (w[i] << 2) | (w[i - 1] >> 62));
+    w[0] = add_mod3_cells(w[0], w[0] << 2);
+}
+
+void IMD::Pascal_row_mod3::goto_index(index_type index)
+{
+    if (index == this->__curr_index)
+        return;
+    if (index == this->__curr_index + 1)
+    {
+        this->next();
+        return;
+    }
+
+    this->__curr_index = index;
+    this->__words.assign(index / cells_per_word + 1, 0);
+    for (index_type k(0); k <= index; ++k)
+        this->__words[k / cells_per_word] |= word_type(binomial_coefficient_mod3(k, index)) << (2 * (k % cells_per_word));
+}
+
+void IMD::Pascal_row_mod3::reset()
+{
+    this->__curr_index = 0;
+    this->__words.assign(1, 1);
+}
+
+std::vector<std::vector<std::uint64_t>> IMD::Pascal_triangle_mod2(size_t rows_amount)
+{
+    IMD_PROBE_CALL(Pascal_triangle_mod2);
+    IMD_PROBE_ALLOCATION(Pascal_triangle_mod2, rows_amount * sizeof(std::vector<std::uint64_t>));
+
+    std::vector<std::vector<std::uint64_t>> res;
+    res.reserve(rows_amount);
+
+    Pascal_row_mod2 row;
+    for (size_t i(0); i < rows_amount; ++i, row.next())
+    {
+        IMD_PROBE_ALLOCATION(Pascal_triangle_mod2, row.words().size() * sizeof(std::uint64_t));
+        res.push_back(row.words());
+    }
+    return res;
+}
+std::vector<std::vector<std::uint64_t>> IMD::Pascal_triangle_mod3(size_t rows_amount)
+{
+    IMD_PROBE_CALL(Pascal_triangle_mod3);
+    IMD_PROBE_ALLOCATION(Pascal_triangle_mod3, rows_amount * sizeof(std::vector<std::uint64_t>));
+
+    std::vector<std::vector<std::uint64_t>> res;
+    res.reserve(rows_amount);
+
+    Pascal_row_mod3 row;
+    for (size_t i(0); i < rows_amount; ++i, row.next())
+    {
+        IMD_PROBE_ALLOCATION(Pascal_triangle_mod3, row.words().size() * sizeof(std::uint64_t));
+        res.push_back(row.words());
+    }
+    return res;
+}
+
+namespace
+{
+    // Inverse of the unit 'a' modulo 'm' (extended Euclidean algorithm)
+    unsigned long long inverse_modulo(unsigned long long a, unsigned long long m) noexcept
+    {
+        long long old_r(a % m), r(m), old_s(1), s(0);
+        while (r != 0)
+        {
+            long long q = old_r / r;
+            std::tie(old_r, r) = std::make_tuple(r, old_r - q * r);
+            std::tie(old_s, s) = std::make_tuple(s, old_s - q * s);
+        }
+        return static_cast<unsigned long long>((old_s % (long long)m + (long long)m) % (long long)m);
+    }
+
+    bool is_prime(unsigned long long num) noexcept
+    {
+        if (num < 2)
+            return false;
+        for (unsigned long long d(2); d * d <= num; ++d)
+            if (num % d == 0)
+                return false;
+        return true;
+    }
+}
+
+IMD::binomial_modulo_solver::binomial_modulo_solver(const binomial_modulo_solver &other)
+    : __tables(other.__tables), __moduli(other.__moduli) {}
+
+IMD::binomial_modulo_solver::binomial_modulo_solver(binomial_modulo_solver &&other) noexcept
+    : __tables(std::move(other.__tables)), __moduli(std::move(other.__moduli)) {}
+
+IMD::binomial_modulo_solver &IMD::binomial_modulo_solver::operator=(const binomial_modulo_solver &other)
+{
+    if (this != &other)
+    {
+        this->__tables = other.__tables;
+        this->__moduli = other.__moduli;
+    }
+    return *this;
+}
+
+IMD::binomial_modulo_solver &IMD::binomial_modulo_solver::operator=(binomial_modulo_solver &&other) noexcept
+{
+    this->__tables = std::move(other.__tables);
+    this->__moduli = std::move(other.__moduli);
+    return *this;
+}
+
+const IMD::binomial_modulo_solver::prime_power_table &IMD::binomial_modulo_solver::table(element_type prime, size_t exponent)
+{
+    element_type modulus(1);
+    for (size_t i(0); i < exponent; ++i)
+    {
+        if (modulus > max_table_modulus / prime)
+            throw std::invalid_argument("The prime power is more than 'max_table_modulus'");
+        modulus *= prime;
+    }
+
+    // The primality is checked once per table: a cached p^e with another prime means 'prime' is not a prime
+    auto it = this->__tables.find(modulus);
+    if (it != this->__tables.end())
+    {
+        if (it->second.prime != prime)
+            throw std::invalid_argument("The argument 'prime' is not a prime number");
+        return it->second;
+    }
+    if (!is_prime(prime))
+        throw std::invalid_argument("The argument 'prime' is not a prime number");
+
+    IMD_PROBE_ALLOCATION(modular_binomial_coefficient, (exponent == 1 ? 2 : 1) * modulus * sizeof(element_type));
+
+    prime_power_table t{prime, modulus, exponent, std::vector<element_type>(modulus), {}};
+    t.factorials[0] = 1 % modulus;
+    for (element_type i(1); i < modulus; ++i)
+        t.factorials[i] = (i % prime == 0) ? t.factorials[i - 1] : t.factorials[i - 1] * i % modulus;
+
+    if (exponent == 1)
+    {
+        t.inverse_factorials.resize(modulus);
+        t.inverse_factorials[modulus - 1] = inverse_modulo(t.factorials[modulus - 1], modulus);
+        for (element_type i(modulus - 1); i > 0; --i)
+            t.inverse_factorials[i - 1] = t.inverse_factorials[i] * i % modulus;
+    }
+
+    return this->__tables.emplace(modulus, std::move(t)).first->second;
+}
+
+const std::vector<IMD::binomial_modulo_solver::element_type> &IMD::binomial_modulo_solver::factorization(element_type modulus)
+{
+    auto it = this->__moduli.find(modulus);
+    if (it != this->__moduli.end())
+    {
+        if (it->second.empty())
+            throw std::invalid_argument("The prime power is more than 'max_table_modulus'");
+        return it->second;
+    }
+
+    std::vector<element_type> prime_powers;
+    try
+    {
+        element_type rest(modulus);
+        for (element_type d(2); d <= max_table_modulus && d * d <= rest; ++d)
+        {
+            if (rest % d != 0)
+                continue;
+
+            size_t exponent(0);
+            while (rest % d == 0)
+            {
+                rest /= d;
+                ++exponent;
+            }
+            prime_powers.push_back(this->table(d, exponent).modulus);
+        }
+        if (rest > 1)
+            prime_powers.push_back(this->table(rest, 1).modulus);
+    }
+    catch (const std::invalid_argument &)
+    {
+        // The trial division up to 'max_table_modulus' is not repeated for the same modulus
+        this->__moduli.emplace(modulus, std::vector<element_type>());
+        throw;
+    }
+
+    return this->__moduli.emplace(modulus, std::move(prime_powers)).first->second;
+}
+
+IMD::binomial_modulo_solver::element_type IMD::binomial_modulo_solver::Lucas(index_type k, index_type n, const prime_power_table &t) const noexcept
+{
+    const element_type p = t.prime;
+    element_type res(1 % p);
+    while (k > 0 && res != 0)
+    {
+        const index_type n_i = n % p, k_i = k % p;
+        if (k_i > n_i)
+            return 0;
+        res = res * t.factorials[n_i] % p * t.inverse_factorials[k_i] % p * t.inverse_factorials[n_i - k_i] % p;
+        n /= p;
+        k /= p;
+    }
+    return res;
+}
+
+IMD::binomial_modulo_solver::element_type IMD::binomial_modulo_solver::Granville(index_type k, index_type n, const prime_power_table &t) const noexcept
+{
+    const element_type p = t.prime, q = t.modulus;
+
+    // Kummer: the power of p in C(n, k) is the number of carries when adding k and n - k in base p
+    size_t carries(0);
+    for (index_type a(k), b(n - k), carry(0); a > 0 || b > 0 || carry > 0; a /= p, b /= p)
+    {
+        carry = (a % p + b % p + carry) >= p ? 1 : 0;
+        carries += carry;
+    }
+    if (carries >= t.exponent)
+        return 0;
+
+    // The product of the units modulo p^e is -1, except for p = 2 and e >= 3
+    const bool negative_units = !(p == 2 && t.exponent >= 3);
+
+    // n! with all factors of p removed, modulo p^e
+    auto unit_factorial = [&](index_type num) noexcept
+    {
+        element_type res(1 % q);
+        bool negative(false);
+        while (num > 1)
+        {
+            if (negative_units && (num / q) % 2 == 1)
+                negative = !negative;
+            res = res * t.factorials[num % q] % q;
+            num /= p;
+        }
+        return negative ? (q - res) % q : res;
+    };
+
+    element_type res = unit_factorial(n);
+    res = res * inverse_modulo(unit_factorial(k), q) % q;
+    res = res * inverse_modulo(unit_factorial(n - k), q) % q;
+    for (size_t i(0); i < carries; ++i)
+        res = res * p % q;
+    return res;
+}
+
+IMD::binomial_modulo_solver::element_type IMD::binomial_modulo_solver::Lucas(index_type k, index_type n, element_type prime)
+{
+    IMD_PROBE_CALL(modular_binomial_coefficient);
+
+    if (k > n)
+        throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
+    if (prime < 2)
+        throw std::invalid_argument("The argument 'prime' is not a prime number");
+
+    return this->Lucas(k, n, this->table(prime, 1));
+}
+
+IMD::binomial_modulo_solver::element_type IMD::binomial_modulo_solver::Granville(index_type k, index_type n, element_type prime, size_t exponent)
+{
+    IMD_PROBE_CALL(modular_binomial_coefficient);
+
+    if (k > n)
+        throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
+    if (prime < 2)
+        throw std::invalid_argument("The argument 'prime' is not a prime number");
+    if (exponent == 0)
+        throw std::invalid_argument("The argument 'exponent' is zero");
+
+    const prime_power_table &t = this->table(prime, exponent);
+    return (exponent == 1) ? this->Lucas(k, n, t) : this->Granville(k, n, t);
+}
+
+IMD::binomial_modulo_solver::element_type IMD::binomial_modulo_solver::binomial(index_type k, index_type n, element_type modulus)
+{
+    IMD_PROBE_CALL(modular_binomial_coefficient);
+
+    if (k > n)
+        throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
+    if (modulus == 0)
+        throw std::invalid_argument("The argument 'modulus' is zero");
+    if (modulus == 1)
+        return 0;
+
+    // Garner's form of CRT: every intermediate value stays below the product of the processed moduli
+    element_type res(0), processed(1);
+    for (element_type q : this->factorization(modulus))
+    {
+        const prime_power_table &t = this->__tables.at(q);
+        const element_type r = (t.exponent == 1) ? this->Lucas(k, n, t) : this->Granville(k, n, t);
+
+        const element_type diff = (r + q - res % q) % q;
+        res += processed * (diff * inverse_modulo(processed % q, q) % q);
+        processed *= q;
+    }
+    return res;
+}
+
+size_t IMD::binomial_modulo_solver::cached_tables() const noexcept
+{
+    return this->__tables.size();
+}
+
+void IMD::binomial_modulo_solver::clear() noexcept
+{
+    this->__tables.clear();
+    this->__moduli.clear();
+}
+
+namespace
+{
+    IMD::binomial_modulo_solver &thread_binomial_modulo_solver()
+    {
+        thread_local IMD::binomial_modulo_solver solver;
+        return solver;
+    }
+}
+
+unsigned long long IMD::Lucas_binomial_coefficient(unsigned long long k, unsigned long long n, unsigned long long prime)
+{
+    return thread_binomial_modulo_solver().Lucas(k, n, prime);
+}
+unsigned long long IMD::Granville_binomial_coefficient(unsigned long long k, unsigned long long n, unsigned long long prime, size_t exponent)
+{
+    return thread_binomial_modulo_solver().Granville(k, n, prime, exponent);
+}
+unsigned long long IMD::modular_binomial_coefficient(unsigned long long k, unsigned long long n, unsigned long long modulus)
+{
+    return thread_binomial_modulo_solver().binomial(k, n, modulus);
+}
+
+namespace
+{
+    using limb_vector = std::vector<IMD::big_unsigned::limb_type>;
+
+    // Below the threshold Karatsuba doesn't pay off
+    constexpr size_t karatsuba_threshold = 48;
+
+    void trim(limb_vector &v) noexcept
+    {
+        while (!v.empty() && v.back() == 0)
+            v.pop_back();
+    }
+
+    // res += v << (32 * shift), 'res' has to be large enough
+    void add_shifted(limb_vector &res, const limb_vector &v, size_t shift) noexcept
+    {
+        std::uint64_t carry(0);
+        size_t i(0);
+        for (; i < v.size(); ++i)
+        {
+            carry += std::uint64_t(res[i + shift]) + v[i];
+            res[i + shift] = static_cast<std::uint32_t>(carry);
+            carry >>= 32;
+        }
+        for (i += shift; carry != 0; ++i)
+        {
+            carry += res[i];
+            res[i] = static_cast<std::uint32_t>(carry);
+            carry >>= 32;
+        }
+    }
+
+    // a -= b, requires a >= b
+    void subtract(limb_vector &a, const limb_vector &b) noexcept
+    {
+        std::int64_t borrow(0);
+        for (size_t i(0); i < a.size() && (i < b.size() || borrow != 0); ++i)
+        {
+            std::int64_t diff = std::int64_t(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+            borrow = diff < 0 ? 1 : 0;
+            a[i] = static_cast<std::uint32_t>(diff + (borrow << 32));
+        }
+        trim(a);
+    }
+
+    limb_vector add(const limb_vector &a, const limb_vector &b)
+    {
+        limb_vector res(std::max(a.size(), b.size()) + 1, 0);
+        std::copy(a.begin(), a.end(), res.begin());
+        add_shifted(res, b, 0);
+        trim(res);
+        return res;
+    }
+
+    limb_vector schoolbook_multiply(const limb_vector &a, const limb_vector &b)
+    {
+        if (a.empty() || b.empty())
+            return {};
+
+        limb_vector res(a.size() + b.size(), 0);
+        for (size_t i(0); i < a.size(); ++i)
+        {
+            std::uint64_t carry(0);
+            for (size_t j(0); j < b.size(); ++j)
+            {
+                carry += std::uint64_t(a[i]) * b[j] + res[i + j];
+                res[i + j] = static_cast<std::uint32_t>(carry);
+                carry >>= 32;
+            }
+            res[i + b.size()] = static_cast<std::uint32_t>(carry);
+        }
+        trim(res);
+        return res;
+    }
+
+    limb_vector karatsuba_multiply(const limb_vector &a, const limb_vector &b, size_t threads)
+    {
+        if (a.size() < b.size())
+            return karatsuba_multiply(b, a, threads);
+        if (b.size() < karatsuba_threshold)
+            return schoolbook_multiply(a, b);
+
+        limb_vector res(a.size() + b.size(), 0);
+
+        // Unbalanced operands: multiply 'b' by the chunks of 'a' of the same length
+        if (a.size() >= 2 * b.size())
+        {
+            for (size_t pos(0); pos < a.size(); pos += b.size())
+            {
+                limb_vector chunk(a.begin() + pos, a.begin() + std::min(a.size(), pos + b.size()));
+                trim(chunk);
+                add_shifted(res, karatsuba_multiply(chunk, b, threads), pos);
+            }
+            trim(res);
+            return res;
+        }
+
+        const size_t half = a.size() / 2;
+        limb_vector a0(a.begin(), a.begin() + half), a1(a.begin() + half, a.end());
+        limb_vector b0(b.begin(), b.begin() + half), b1(b.begin() + half, b.end());
+        trim(a0);
+        trim(b0);
+
+        limb_vector z0, z1, z2;
+        if (threads > 1)
+        {
+            auto low = std::async(std::launch::async, karatsuba_multiply, std::cref(a0), std::cref(b0), threads / 3);
+            auto high = std::async(std::launch::async, karatsuba_multiply, std::cref(a1), std::cref(b1), threads / 3);
+            z1 = karatsuba_multiply(add(a0, a1), add(b0, b1), threads - 2 * (threads / 3));
+            z0 = low.get();
+            z2 = high.get();
+        }
+        else
+        {
+            z0 = karatsuba_multiply(a0, b0, 1);
+            z2 = karatsuba_multiply(a1, b1, 1);
+            z1 = karatsuba_multiply(add(a0, a1), add(b0, b1), 1);
+        }
+        subtract(z1, z0);
+        subtract(z1, z2);
+
+        add_shifted(res, z0, 0);
+        add_shifted(res, z1, half);
+        add_shifted(res, z2, 2 * half);
+        trim(res);
+        return res;
+    }
+}
+
+IMD::big_unsigned::big_unsigned(unsigned long long value)
+{
+    while (value != 0)
+    {
+        this->__limbs.push_back(static_cast<limb_type>(value));
+        value >>= 32;
+    }
+}
+
+IMD::big_unsigned::big_unsigned(std::vector<limb_type> limbs)
+    : __limbs(std::move(limbs))
+{
+    trim(this->__limbs);
+}
+
+IMD::big_unsigned::big_unsigned(const big_unsigned &other)
+    : __limbs(other.__limbs) {}
+
+IMD::big_unsigned::big_unsigned(big_unsigned &&other) noexcept
+    : __limbs(std::move(other.__limbs)) {}
+
+IMD::big_unsigned &IMD::big_unsigned::operator=(const big_unsigned &other)
+{
+    if (this != &other)
+        this->__limbs = other.__limbs;
+    return *this;
+}
+
+IMD::big_unsigned &IMD::big_unsigned::operator=(big_unsigned &&other) noexcept
+{
+    this->__limbs = std::move(other.__limbs);
+    return *this;
+}
+
+IMD::big_unsigned &IMD::big_unsigned::operator+=(const big_unsigned &other)
+{
+    this->__limbs.resize(std::max(this->__limbs.size(), other.__limbs.size()) + 1, 0);
+    add_shifted(this->__limbs, other.__limbs, 0);
+    trim(this->__limbs);
+    return *this;
+}
+
+bool IMD::big_unsigned::operator==(const big_unsigned &other) const noexcept
+{
+    return this->__limbs == other.__limbs;
+}
+bool IMD::big_unsigned::operator!=(const big_unsigned &other) const noexcept
+{
+    return !this->operator==(other);
+}
+
+IMD::big_unsigned &IMD::big_unsigned::operator*=(limb_type factor)
+{
+    if (factor == 0)
+    {
+        this->__limbs.clear();
+        return *this;
+    }
+
+    std::uint64_t carry(0);
+    for (limb_type &limb : this->__limbs)
+    {
+        carry += std::uint64_t(limb) * factor;
+        limb = static_cast<limb_type>(carry);
+        carry >>= 32;
+    }
+    if (carry != 0)
+        this->__limbs.push_back(static_cast<limb_type>(carry));
+    return *this;
+}
+IMD::big_unsigned &IMD::big_unsigned::operator*=(const big_unsigned &other)
+{
+    this->__limbs = karatsuba_multiply(this->__limbs, other.__limbs, 1);
+    return *this;
+}
+IMD::big_unsigned IMD::big_unsigned::operator*(const big_unsigned &other) const
+{
+    return big_unsigned(karatsuba_multiply(this->__limbs, other.__limbs, 1));
+}
+
+IMD::big_unsigned IMD::big_unsigned::multiply(const big_unsigned &lhs, const big_unsigned &rhs, size_t threads)
+{
+    return big_unsigned(karatsuba_multiply(lhs.__limbs, rhs.__limbs, std::max<size_t>(threads, 1)));
+}
+
+const std::vector<IMD::big_unsigned::limb_type> &IMD::big_unsigned::limbs() const noexcept
+{
+    return this->__limbs;
+}
+size_t IMD::big_unsigned::bits() const noexcept
+{
+    if (this->__limbs.empty())
+        return 0;
+
+    size_t res = 32 * (this->__limbs.size() - 1);
+    for (limb_type top = this->__limbs.back(); top != 0; top >>= 1)
+        ++res;
+    return res;
+}
+bool IMD::big_unsigned::is_zero() const noexcept
+{
+    return this->__limbs.empty();
+}
+
+// Warning: the conversion is quadratic in the amount of limbs
+std::string IMD::big_unsigned::to_string() const
+{
+    if (this->__limbs.empty())
+        return "0";
+
+    constexpr limb_type chunk_base = 1000000000;
+    limb_vector tmp(this->__limbs);
+    std::vector<limb_type> chunks; // base 10^9, little endian
+
+    while (!tmp.empty())
+    {
+        std::uint64_t rem(0);
+        for (size_t i(tmp.size()); i > 0; --i)
+        {
+            std::uint64_t cur = (rem << 32) | tmp[i - 1];
+            tmp[i - 1] = static_cast<limb_type>(cur / chunk_base);
+            rem = cur % chunk_base;
+        }
+        trim(tmp);
+        chunks.push_back(static_cast<limb_type>(rem));
+    }
+
+    std::string res = std::to_string(chunks.back());
+    for (size_t i(chunks.size() - 1); i > 0; --i)
+    {
+        std::string chunk = std::to_string(chunks[i - 1]);
+        res.append(9 - chunk.size(), '0');
+        res += chunk;
+    }
+    return res;
+}
+
+std::vector<size_t> IMD::primes_up_to(size_t n)
+{
+    std::vector<size_t> res;
+    if (n < 2)
+        return res;
+
+    const size_t root = static_cast<size_t>(std::sqrt(static_cast<double>(n))) + 1;
+
+    // Base primes up to sqrt(n)
+    std::vector<bool> composite(root + 1, false);
+    for (size_t i(2); i <= root; ++i)
+    {
+        if (composite[i])
+            continue;
+        if (i <= n)
+            res.push_back(i);
+        for (size_t j(i * i); j <= root; j += i)
+            composite[j] = true;
+    }
+    const size_t base_amount = res.size();
+
+    // Segments fit into L1 cache
+    constexpr size_t segment_size = 32768;
+    std::vector<char> segment(segment_size);
+    for (size_t low(root + 1); low <= n; low += segment_size)
+    {
+        const size_t high = std::min(n, low + segment_size - 1);
+        std::fill(segment.begin(), segment.end(), 0);
+
+        for (size_t i(0); i < base_amount; ++i)
+        {
+            const size_t p = res[i];
+            for (size_t j(std::max(p * p, (low + p - 1) / p * p)); j <= high; j += p)
+                segment[j - low] = 1;
+        }
+        for (size_t j(low); j <= high; ++j)
+            if (!segment[j - low])
+                res.push_back(j);
+    }
+    return res;
+}
+
+size_t IMD::Legendre_exponent(size_t n, size_t prime)
+{
+    if (prime < 2)
+        throw std::invalid_argument("The argument 'prime' is less than 2");
+
+    size_t res(0);
+    while (n >= prime)
+    {
+        n /= prime;
+        res += n;
+    }
+    return res;
+}
+
+namespace
+{
+    // Product of the factors in [first, last) as a balanced binary tree, the upper levels are run in parallel
+    template <typename T>
+    IMD::big_unsigned product_tree(const T *first, const T *last, size_t threads)
+    {
+        const size_t amount = last - first;
+        if (amount <= 16)
+        {
+            IMD::big_unsigned res(1);
+            for (; first != last; ++first)
+                if (*first <= 0xFFFFFFFFULL)
+                    res *= static_cast<IMD::big_unsigned::limb_type>(*first);
+                else
+                    res *= IMD::big_unsigned(*first);
+            return res;
+        }
+
+        const T *middle = first + amount / 2;
+        if (threads > 1)
+        {
+            auto left = std::async(std::launch::async, product_tree<T>, first, middle, threads / 2);
+            IMD::big_unsigned right = product_tree(middle, last, threads - threads / 2);
+            return IMD::big_unsigned::multiply(left.get(), right, threads);
+        }
+        return product_tree(first, middle, 1) * product_tree(middle, last, 1);
+    }
+
+    // Packs p^e into factors below 2^32, so the product tree leaves are as wide as possible
+    void push_prime_power(std::vector<std::uint32_t> &factors, size_t prime, size_t exponent)
+    {
+        std::uint64_t acc(1);
+        for (size_t i(0); i < exponent; ++i)
+        {
+            if (acc * prime > 0xFFFFFFFFULL)
+            {
+                factors.push_back(static_cast<std::uint32_t>(acc));
+                acc = 1;
+            }
+            acc *= prime;
+        }
+        if (acc > 1)
+            factors.push_back(static_cast<std::uint32_t>(acc));
+    }
+
+    // n! from the exponents of its primes: the product over the bits b of (product of primes with the bit b set)^(2^b)
+    IMD::big_unsigned product_of_prime_powers(const std::vector<size_t> &primes, const std::vector<size_t> &exponents, size_t threads)
+    {
+        size_t max_exponent(0);
+        for (size_t e : exponents)
+            max_exponent = std::max(max_exponent, e);
+
+        IMD::big_unsigned res(1);
+        size_t top_bit(0);
+        while ((max_exponent >> top_bit) > 1)
+            ++top_bit;
+
+        std::vector<std::uint32_t> factors;
+        for (size_t bit(top_bit + 1); bit > 0; --bit)
+        {
+            res = IMD::big_unsigned::multiply(res, res, threads);
+
+            factors.clear();
+            for (size_t i(0); i < primes.size(); ++i)
+                if ((exponents[i] >> (bit - 1)) & 1)
+                    push_prime_power(factors, primes[i], 1);
+            if (!factors.empty())
+                res = IMD::big_unsigned::multiply(res, product_tree(factors.data(), factors.data() + factors.size(), threads), threads);
+        }
+        return res;
+    }
+
+    IMD::big_unsigned prime_swing_factorial(size_t n, const std::vector<size_t> &primes, size_t threads)
+    {
+        if (n < 2)
+            return IMD::big_unsigned(1);
+
+        // swing(n) = n! / ((n / 2)!)^2, the exponent of p is the amount of odd floor(n / p^i)
+        std::vector<std::uint32_t> factors;
+        for (size_t p : primes)
+        {
+            if (p > n)
+                break;
+
+            size_t exponent(0);
+            for (size_t q(n / p); q > 0; q /= p)
+                exponent += q & 1;
+            push_prime_power(factors, p, exponent);
+        }
+
+        IMD::big_unsigned half = prime_swing_factorial(n / 2, primes, threads);
+        IMD::big_unsigned swing = product_tree(factors.data(), factors.data() + factors.size(), threads);
+        return IMD::big_unsigned::multiply(IMD::big_unsigned::multiply(half, half, threads), swing, threads);
+    }
+}
+
+namespace
+{
+    // C(n, k) as the product of n - k + 1, ..., n with the primes of k! divided out of their multiples: k consecutive integers
+    // hold every prime power of k!, so no big division is needed. The work depends on k only, not on the sieve up to n
+    IMD::big_unsigned falling_binomial(size_t k, size_t n, size_t threads)
+    {
+        const unsigned long long first = n - k + 1;
+        std::vector<unsigned long long> factors(k);
+        for (size_t i(0); i < k; ++i)
+            factors[i] = first + i;
+
+        for (size_t p : IMD::primes_up_to(k))
+        {
+            size_t exponent = IMD::Legendre_exponent(k, p);
+            for (size_t i((p - first % p) % p); exponent > 0 && i < k; i += p)
+                for (; exponent > 0 && factors[i] % p == 0; --exponent)
+                    factors[i] /= p;
+        }
+
+        factors.erase(std::remove(factors.begin(), factors.end(), 1ULL), factors.end());
+        return product_tree(factors.data(), factors.data() + factors.size(), std::max<size_t>(threads, 1));
+    }
+}
+
+IMD::big_unsigned IMD::big_factorial(size_t n, size_t threads)
+{
+    IMD_PROBE_CALL(big_factorial);
+
+    if (n > 0xFFFFFFFFULL)
+        throw std::invalid_argument("The argument 'n' is too large");
+
+    return prime_swing_factorial(n, primes_up_to(n), std::max<size_t>(threads, 1));
+}
+
+IMD::big_unsigned IMD::big_multinomial_coefficient(const std::vector<size_t> &parts, size_t threads)
+{
+    IMD_PROBE_CALL(big_multinomial_coefficient);
+
+    size_t n(0);
+    for (size_t k : parts)
+    {
+        if (k > 0xFFFFFFFFULL - n)
+            throw std::invalid_argument("The sum of the argument 'parts' is too large");
+        n += k;
+    }
+
+    const std::vector<size_t> primes = primes_up_to(n);
+    std::vector<size_t> exponents(primes.size());
+    for (size_t i(0); i < primes.size(); ++i)
+    {
+        exponents[i] = Legendre_exponent(n, primes[i]);
+        for (size_t k : parts)
+            exponents[i] -= Legendre_exponent(k, primes[i]);
+    }
+
+    return product_of_prime_powers(primes, exponents, std::max<size_t>(threads, 1));
+}
+
+namespace
+{
+    // Saturating s(j, i) = i * (s(j - 1, i) + s(j - 1, i - 1)) for 2 <= m <= n: every cell reaching s(n, m) is not above it,
+    // so a saturated s(n, m) means overflow. Only the cells with i >= m - (n - j) reach it
+    template <typename T>
+    bool saturating_surjections(size_t n, size_t m, T &res)
+    {
+        constexpr size_t bits = 8 * sizeof(T);
+        if (m > (bits == 64 ? 20 : 34) || n > bits) // m! >= 2^bits or s(n, m) >= 2^n - 2
+            return false;
+
+        constexpr T saturated = ~T(0);
+        std::vector<T> cells(m + 1, 0);
+        cells[0] = 1;
+        for (size_t j(1); j <= n; ++j)
+        {
+            const size_t low = (m + j > n) ? std::max<size_t>(1, m + j - n) : 1;
+            for (size_t i(std::min(j, m)); i >= low; --i)
+            {
+                const T sum = cells[i] + cells[i - 1];
+                cells[i] = (sum < cells[i] || sum > saturated / i) ? saturated : sum * i;
+            }
+            cells[0] = 0;
+        }
+        res = cells[m];
+        return res != saturated;
+    }
+
+    // s(n, m) < 2^(bits of T) for 1 <= m <= n: below m^n < 2^bits it fits, above the saturating recurrence decides
+    template <typename T>
+    bool surjections_fit(size_t n, size_t m)
+    {
+        T res;
+        return n * std::log2(static_cast<double>(m)) < 8 * sizeof(T) - 0.01 || saturating_surjections(n, m, res);
+    }
+}
+
+#ifdef __SIZEOF_INT128__
+std::string IMD::to_string(uint128 value)
+{
+    if (value <= ~0ULL)
+        return std::to_string(static_cast<unsigned long long>(value));
+
+    constexpr unsigned long long chunk_base = 10000000000000000000ULL; // 10^19
+    const std::string low = std::to_string(static_cast<unsigned long long>(value % chunk_base));
+    return to_string(value / chunk_base) + std::string(19 - low.size(), '0') + low;
+}
+
+namespace
+{
+    using IMD::uint128;
+
+    // log2 of the upper bound C(n, k) <= 2^(n H(k / n)) / sqrt(2 pi k (n - k) / n) * e^(1 / 12n - 1 / (12k + 1) - 1 / (12(n - k) + 1))
+    // from Robbins' bounds of the factorials, 0 < k < n. The last term covers the rounding of the logarithms
+    double binomial_bits_bound(size_t k, size_t n) noexcept
+    {
+        const double kk = static_cast<double>(k), nn = static_cast<double>(n), rest = nn - kk;
+        const double entropy = kk * std::log2(nn / kk) + rest * std::log2(nn / rest);
+        const double correction = 1 / (12 * nn) - 1 / (12 * kk + 1) - 1 / (12 * rest + 1);
+        return entropy - 0.5 * std::log2(6.283185307179586 * kk * rest / nn) + 1.4426950408889634 * correction + 1e-9 * nn;
+    }
+
+    template <typename T>
+    T wrapping_power(T base, size_t exponent) noexcept
+    {
+        T res(1);
+        for (; exponent > 0; exponent >>= 1, base *= base)
+            if (exponent & 1)
+                res *= base;
+        return res;
+    }
+
+    // Inclusion-exclusion modulo 2^(bits of T): exact whenever the result fits, however large the terms are
+    template <typename T>
+    T wrapping_surjections(size_t n, size_t m) noexcept
+    {
+        T res(0), coeff(1); // coeff = C(m, i), m^m fits in T here
+        for (size_t i(0); i <= m; ++i)
+        {
+            const T term = coeff * wrapping_power<T>(m - i, n);
+            res = (i & 1) ? res - term : res + term;
+            coeff = coeff * (m - i) / (i + 1);
+        }
+        return res;
+    }
+
+    bool surjections_128(size_t n, size_t m, uint128 &res)
+    {
+        if (n * std::log2(static_cast<double>(m)) < 127.99)
+        {
+            res = wrapping_surjections<uint128>(n, m);
+            return true;
+        }
+        return saturating_surjections(n, m, res);
+    }
+
+    IMD::exact_unsigned narrowest(uint128 value) noexcept
+    {
+        IMD::exact_unsigned res;
+        res.width = (value <= ~0ULL) ? IMD::exact_unsigned::width_type::bits_64 : IMD::exact_unsigned::width_type::bits_128;
+        res.value = value;
+        return res;
+    }
+    IMD::exact_unsigned narrowest(IMD::big_unsigned value) noexcept
+    {
+        IMD::exact_unsigned res;
+        res.width = IMD::exact_unsigned::width_type::arbitrary;
+        res.big = std::move(value);
+        return res;
+    }
+}
+
+IMD::uint128 IMD::binomial_coefficient_128(size_t k, size_t n)
+{
+    IMD_PROBE_CALL(binomial_coefficient_128);
+
+    if (k > n)
+        throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
+    k = std::min(k, n - k);
+
+    bool overflow(false);
+    const uint128 res = reduced_binomial<uint128>(k, n, overflow);
+    IMD_PROBE_OVERFLOW(binomial_coefficient_128, overflow);
+    if (overflow)
+        throw std::overflow_error("The result doesn't fit in 128 bits");
+    return res;
+}
+
+IMD::uint128 IMD::factorial_128(size_t n)
+{
+    IMD_PROBE_CALL(factorial_128);
+    IMD_PROBE_OVERFLOW(factorial_128, n > 34);
+
+    if (n > 34)
+        throw std::overflow_error("The result doesn't fit in 128 bits");
+
+    uint128 res(1);
+    for (size_t i(2); i <= n; ++i)
+        res *= i;
+    return res;
+}
+
+IMD::uint128 IMD::surjective_mappings_128(size_t n, size_t m)
+{
+    IMD_PROBE_CALL(surjective_mappings_128);
+
+    if (m == 0)
+        return (n == 0) ? 1 : 0;
+    if (n < m)
+        return 0;
+
+    uint128 res;
+    const bool fits = surjections_128(n, m, res);
+    IMD_PROBE_OVERFLOW(surjective_mappings_128, !fits);
+    if (!fits)
+        throw std::overflow_error("The result doesn't fit in 128 bits");
+    return res;
+}
+
+std::string IMD::exact_unsigned::to_string() const
+{
+    return (this->width == width_type::arbitrary) ? this->big.to_string() : IMD::to_string(this->value);
+}
+
+IMD::exact_unsigned IMD::exact_binomial_coefficient(size_t k, size_t n, size_t threads)
+{
+    IMD_PROBE_CALL(exact_binomial_coefficient);
+
+    if (k > n)
+        throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
+    k = std::min(k, n - k);
+    if (k == 0)
+        return narrowest(uint128(1));
+
+    // The bound only picks the first width to try, the reduced products detect overflow exactly
+    const double bits = binomial_bits_bound(k, n);
+    bool overflow(false);
+    if (bits < 64)
+    {
+        const unsigned long long res = reduced_binomial<unsigned long long>(k, n, overflow);
+        if (!overflow)
+            return narrowest(uint128(res));
+        overflow = false;
+    }
+    if (bits < 128)
+    {
+        const uint128 res = reduced_binomial<uint128>(k, n, overflow);
+        if (!overflow)
+            return narrowest(res);
+    }
+    // The prime swing sieves every prime up to n, below k = n / 8 the k factors of the falling product are cheaper
+    if (k <= n / 8 || n > 0xFFFFFFFFULL)
+        return narrowest(falling_binomial(k, n, threads));
+    return narrowest(big_multinomial_coefficient({k, n - k}, threads));
+}
+
+IMD::exact_unsigned IMD::exact_factorial(size_t n, size_t threads)
+{
+    IMD_PROBE_CALL(exact_factorial);
+
+    if (n <= 20)
+        return narrowest(uint128(iterative_factorial(n)));
+    if (n <= 34)
+        return narrowest(factorial_128(n));
+    return narrowest(big_factorial(n, threads));
+}
+
+IMD::exact_unsigned IMD::exact_surjective_mappings(size_t n, size_t m)
+{
+    IMD_PROBE_CALL(exact_surjective_mappings);
+
+    if (m == 0)
+        return narrowest(uint128(n == 0 ? 1 : 0));
+    if (n < m)
+        return narrowest(uint128(0));
+
+    if (n * std::log2(static_cast<double>(m)) < 63.99) // m^n is above every surjection count
+        return narrowest(uint128(wrapping_surjections<unsigned long long>(n, m)));
+
+    uint128 res;
+    if (surjections_128(n, m, res))
+        return narrowest(res);
+
+    if (m > 0xFFFFFFFFULL)
+        throw std::invalid_argument("The argument 'm' is too large");
+
+    // s(j, i) = i * (s(j - 1, i) + s(j - 1, i - 1)) in arbitrary precision
+    std::vector<big_unsigned> cells(m + 1);
+    cells[0] = big_unsigned(1);
+    for (size_t j(1); j <= n; ++j)
+    {
+        const size_t low = (m + j > n) ? std::max<size_t>(1, m + j - n) : 1;
+        for (size_t i(std::min(j, m)); i >= low; --i)
+        {
+            cells[i] += cells[i - 1];
+            cells[i] *= static_cast<big_unsigned::limb_type>(i);
+        }
+        cells[0] = big_unsigned(0);
+    }
+    return narrowest(std::move(cells[m]));
+}
+#endif
+
+namespace
+{
+    constexpr size_t log_factorial_table_size = 256;
+
+    // log k! for k < 256 correctly rounded. A constant table (not a lazily filled one) can't alias the outputs of the batches,
+    // so their lookups are vectorized as gathers
+    constexpr double log_factorial_table[log_factorial_table_size] = {
+        0, 0, 0.69314718055994529, 1.791759469228055,
+        3.1780538303479458, 4.7874917427820458, 6.5792512120101012, 8.5251613610654147,
+        10.604602902745251, 12.801827480081469, 15.104412573075516, 17.502307845873887,
+        19.987214495661885, 22.552163853123425, 25.19122118273868, 27.89927138384089,
+        30.671860106080672, 33.505073450136891, 36.395445208033053, 39.339884187199495,
+        42.335616460753485, 45.380138898476908, 48.471181351835227, 51.606675567764377,
+        54.784729398112319, 58.003605222980518, 61.261701761002001, 64.557538627006338,
+        67.88974313718154, 71.257038967168015, 74.658236348830158, 78.092223553315307,
+        81.557959456115043, 85.054467017581516, 88.580827542197682, 92.136175603687093,
+        95.719694542143202, 99.330612454787428, 102.96819861451381, 106.63176026064346,
+        110.32063971475739, 114.03421178146171, 117.77188139974507, 121.53308151543864,
+        125.3172711493569, 129.12393363912722, 132.95257503561632, 136.80272263732635,
+        140.67392364823425, 144.5657439463449, 148.47776695177302, 152.40959258449735,
+        156.3608363030788, 160.3311282166309, 164.32011226319517, 168.32744544842765,
+        172.35279713916279, 176.39584840699735, 180.45629141754378, 184.53382886144948,
+        188.6281734236716, 192.7390472878449, 196.86618167289001, 201.00931639928152,
+        205.1681994826412, 209.34258675253685, 213.53224149456327, 217.73693411395422,
+        221.95644181913033, 226.1905483237276, 230.43904356577696, 234.70172344281826,
+        238.97838956183432, 243.26884900298271, 247.57291409618688, 251.89040220972319,
+        256.22113555000954, 260.56494097186322, 264.92164979855278, 269.29109765101981,
+        273.67312428569369, 278.06757344036612, 282.4742926876304, 286.89313329542699,
+        291.32395009427029, 295.76660135076065, 300.22094864701415, 304.68685676566872,
+        309.1641935801469, 313.65282994987905, 318.1526396202093, 322.66349912672615,
+        327.1852877037752, 331.71788719692847, 336.26118197919845, 340.81505887079902,
+        345.37940706226686, 349.95411804077025, 354.53908551944079, 359.1342053695754,
+        363.73937555556347, 368.35449607240474, 372.97946888568902, 377.61419787391867,
+        382.25858877306001, 386.91254912321756, 391.57598821732961, 396.24881705179155,
+        400.93094827891576, 405.6222961611449, 410.32277652693733, 415.03230672824964,
+        419.75080559954472, 424.47819341825709, 429.21439186665157, 433.95932399501481,
+        438.71291418612117, 443.47508812091894, 448.24577274538461, 453.02489623849613,
+        457.81238798127816, 462.60817852687489, 467.4121995716082, 472.22438392698058,
+        477.04466549258564, 481.87297922988796, 486.70926113683942, 491.55344822329801,
+        496.40547848721764, 501.2652908915793, 506.13282534203489, 511.00802266523601,
+        515.89082458782241, 520.78117371604412, 525.67901351599505, 530.58428829443346,
+        535.49694318016952, 540.41692410599762, 545.34417779115483, 550.27865172428551,
+        555.22029414689484, 560.16905403727299, 565.12488109487435, 570.08772572513419,
+        575.0575390247102, 580.0342727671308, 585.01787938883911, 590.00831197561786,
+        595.00552424938201, 600.00947055532743, 605.02010584942366, 610.03738568623862,
+        615.06126620708494, 620.09170412847732, 625.12865673089095, 630.1720818478102,
+        635.22193785505976, 640.27818366040799, 645.34077869343503, 650.40968289565524,
+        655.48485671088906, 660.56626107587351, 665.65385741110595, 670.74760761191271,
+        675.84747403973688, 680.95341951363741, 686.06540730199401, 691.1834011144108,
+        696.30736509381404, 701.43726380873704, 706.57306224578736, 711.71472580228999,
+        716.86222027910344, 722.01551187360121, 727.17456717281573, 732.33935314673931,
+        737.50983714177744, 742.68598687435122, 747.86777042464337, 753.05515623048416,
+        758.2481130813743, 763.44661011264009, 768.65061679971689, 773.86010295255835,
+        779.07503871016729, 784.29539453524569, 789.52114120895885, 794.75224982581346,
+        799.98869178864345, 805.23043880370301, 810.47746287586358, 815.72973630391016,
+        820.98723167593789, 826.2499218648428, 831.5177800239062, 836.7907795824699,
+        842.06889424170038, 847.35209797043842, 852.64036500113298, 857.93366982585746,
+        863.23198719240543, 868.53529210046452, 873.84355979786574, 879.15676577690749,
+        884.47488577075171, 889.79789574989013, 895.12577191867979, 900.45849071194516,
+        905.79602879164645, 911.13836304361121, 916.4854705743287, 921.83732870780477,
+        927.19391498247683, 932.55520714818624, 937.92118316320807, 943.29182119133577,
+        948.66709959901993, 954.04699695256033, 959.43149201534948, 964.82056374516594,
+        970.21419129151832, 975.61235399303609, 981.01503137490829, 986.42220314636847,
+        991.83384919822345, 997.24994960042795, 1002.6704845997002, 1008.0954346171816,
+        1013.5247802461361, 1018.9585022496902, 1024.3965815586134, 1029.8389992691352,
+        1035.2857366408016, 1040.7367750943672, 1046.1920962097249, 1051.6516817238692,
+        1057.1155135288948, 1062.5835736700299, 1068.0558443437014, 1073.5323078956328,
+        1079.0129468189748, 1084.4977437524656, 1089.9866814786221, 1095.4797429219627,
+        1100.976911147256, 1106.4781693578007, 1111.983500893733, 1117.492889230361,
+        1123.0063179765259, 1128.5237708729908, 1134.045231790853, 1139.5706847299848,
+        1145.1001138174961, 1150.6335033062237, 1156.1708375732421, 1161.7121011184006};
+
+    // Two exact halves through the 2^52 exponent trick and one rounding: the same value as static_cast<double>(n), but built
+    // from integer operations that are vectorized without the 64-bit conversions of AVX-512. -ffast-math would reassociate the
+    // 2^52 terms into the sums of the caller, so there it is the plain conversion
+    inline double to_double(unsigned long long n) noexcept
+    {
+#ifdef __FAST_MATH__
+        return static_cast<double>(n);
+#else
+        constexpr unsigned long long exponent_52 = 0x4330000000000000ULL;
+        const unsigned long long high_bits = (n >> 32) | exponent_52, low_bits = (n & 0xFFFFFFFFULL) | exponent_52;
+        double high, low;
+        std::memcpy(&high, &high_bits, sizeof(double));
+        std::memcpy(&low, &low_bits, sizeof(double));
+        return (high - 4503599627370496.0) * 4294967296.0 + (low - 4503599627370496.0);
+#endif
+    }
+
+    // log x for a positive normal x within 1 ulp: fdlibm's __ieee754_log without the branches of the special cases. It only
+    // needs +, *, / and integer operations on the bits, so the batches vectorize without -ffast-math and the vector math library
+    inline double kernel_log(double x) noexcept
+    {
+        // x = 2^e * m with m in [sqrt(2) / 2, sqrt(2))
+        std::uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(double));
+        bits += (0x3FF00000ULL - 0x3FE6A09EULL) << 32;
+        const double e = to_double(bits >> 52) - 1023;
+        bits = (bits & 0x000FFFFFFFFFFFFFULL) + (0x3FE6A09EULL << 32);
+        double m;
+        std::memcpy(&m, &bits, sizeof(double));
+
+        // log(1 + f) = 2s + s R(s^2) with s = f / (2 + f), R is fdlibm's minimax polynomial
+        const double f = m - 1, half_square = 0.5 * f * f, s = f / (2 + f), z = s * s, w = z * z;
+        const double even = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+        const double odd = z * (6.666666666666735130e-01 + w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+        return s * (half_square + odd + even) + e * 1.90821492927058770002e-10 - half_square + f + e * 6.93147180369123816490e-01;
+    }
+
+    // log1p y for y >= -1/2 within a few ulp: log u with u = 1 + y plus the first order correction of the rounding of u
+    inline double kernel_log1p(double y) noexcept
+    {
+        const double u = 1 + y;
+        return kernel_log(u) + (y - (u - 1)) / u;
+    }
+
+    // The logarithms of the single queries and of the batch kernels
+    struct standard_math
+    {
+        static double log(double x) noexcept { return std::log(x); }
+        static double log1p(double x) noexcept { return std::log1p(x); }
+    };
+#ifdef __FAST_MATH__
+    // -ffast-math folds the rounding correction of kernel_log1p away, and glibc declares vector versions of log and log1p
+    using kernel_math = standard_math;
+#else
+    struct kernel_math
+    {
+        static double log(double x) noexcept { return kernel_log(x); }
+        static double log1p(double x) noexcept { return kernel_log1p(x); }
+    };
+#endif
+
+    // lgamma(x) - ((x - 1/2) log x - x + log(2 pi) / 2) for x >= 128, the first omitted term 1/(1188 x^9) is below 1e-22
+    inline double Stirling_tail(double x) noexcept
+    {
+        const double r = 1 / x, r2 = r * r;
+        return r * (1.0 / 12 - r2 * (1.0 / 360 - r2 * (1.0 / 1260 - r2 / 1680)));
+    }
+
+    // log n! = lgamma(n + 1) = (n + 1/2) log n - n + log(2 pi) / 2 + Stirling_tail(n), n >= 256
+    template <typename Math = standard_math>
+    inline double large_log_factorial(double n) noexcept
+    {
+        return (n + 0.5) * Math::log(n) - n + 0.91893853320467274178 + Stirling_tail(n);
+    }
+
+    // lgamma(a + k) - lgamma(a) for a >= 128 without subtracting the large lgamma values
+    template <typename Math = standard_math>
+    inline double log_rising_factorial(double a, double k) noexcept
+    {
+        return (a - 0.5) * Math::log1p(k / a) + k * (Math::log(a + k) - 1) + Stirling_tail(a + k) - Stirling_tail(a);
+    }
+
+    // log C(n, k) = k log(n / k) - (n - k) log1p(-k / n) + log(n / (2 pi k (n - k))) / 2 + tails for k, n - k >= 128:
+    // the large terms are positive, so the large log factorials don't cancel either
+    template <typename Math = standard_math>
+    inline double large_log_binomial(double k, double n) noexcept
+    {
+        const double rest = n - k;
+        return k * Math::log(n / k) - rest * Math::log1p(-k / n) + 0.5 * Math::log(n / (k * rest)) - 0.91893853320467274178 +
+               Stirling_tail(n) - Stirling_tail(k) - Stirling_tail(rest);
+    }
+
+    double log_binomial(unsigned long long k, unsigned long long n) noexcept
+    {
+        const double *table = log_factorial_table;
+
+        if (n < log_factorial_table_size)
+            return table[n] - table[k] - table[n - k];
+
+        // a = n - k + 1 > n / 2 >= 128
+        k = std::min(k, n - k);
+        if (k < log_factorial_table_size)
+            return log_rising_factorial(static_cast<double>(n - k + 1), static_cast<double>(k)) - table[k];
+        return large_log_binomial(static_cast<double>(k), static_cast<double>(n));
+    }
+}
+
+double IMD::log_factorial(unsigned long long n) noexcept
+{
+    IMD_PROBE_CALL(log_factorial);
+
+    return (n < log_factorial_table_size) ? log_factorial_table[n] : large_log_factorial(static_cast<double>(n));
+}
+
+double IMD::log_binomial_coefficient(unsigned long long k, unsigned long long n)
+{
+    IMD_PROBE_CALL(log_binomial_coefficient);
+
+    if (k > n)
+        throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
+    return log_binomial(k, n);
+}
+
+// log (k_1 + ... + k_m)! / (k_1! ... k_m!) = sum of log C(k_1 + ... + k_i, k_i), so no large log factorials cancel
+double IMD::log_multinomial_coefficient(const std::vector<size_t> &parts) noexcept
+{
+    IMD_PROBE_CALL(log_multinomial_coefficient);
+
+    double res(0);
+    unsigned long long n(0);
+    for (size_t k : parts)
+    {
+        n += k;
+        res += log_binomial(k, n);
+    }
+    return res;
+}
+
+// The batch kernels vectorize without -ffast-math: GCC builds an AVX2 and a baseline clone of every kernel and the loader
+// picks one by the CPU (ifunc). Sinking is off, it moves the work of an unused branch behind a jump the vectorizer can't take
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define IMD_VECTOR_KERNEL __attribute__((target_clones("avx2", "default"), optimize("tree-vectorize", "vect-cost-model=cheap", "no-tree-sink")))
+#elif defined(__GNUC__) && !defined(__clang__)
+#define IMD_VECTOR_KERNEL __attribute__((optimize("tree-vectorize", "vect-cost-model=cheap", "no-tree-sink")))
+#else
+#define IMD_VECTOR_KERNEL
+#endif
+
+namespace
+{
+    // The batches walk blocks of queries: a block whose arguments are all tabulated or all large skips the other branch.
+    // Inside a block the branches are computed for every query and blended, with the arguments clamped as integers: a clamp
+    // of doubles is a comparison that may trap, which stops the vectorizer
+    constexpr size_t log_batch_block = 64;
+
+    // out[i] = log_factorial(n[i]) for i in [first, last), 'Small' and 'Large' tell which branches the block needs
+    template <bool Small, bool Large>
+    IMD_VECTOR_KERNEL void log_factorials_block(const unsigned long long *n, size_t first, size_t last, double *out) noexcept
+    {
+        constexpr unsigned long long table_size = log_factorial_table_size;
+
+        if (Large)
+            for (size_t i(first); i < last; ++i)
+            {
+                const unsigned long long m = (n[i] > table_size) ? n[i] : table_size;
+                out[i] = large_log_factorial<kernel_math>(to_double(m));
+            }
+        if (Small)
+            for (size_t i(first); i < last; ++i)
+            {
+                const double small = log_factorial_table[n[i] < table_size ? n[i] : table_size - 1];
+                out[i] = (!Large || n[i] < table_size) ? small : out[i];
+            }
+    }
+
+    // out[i] = log_binomial(k[i], n[i]) for i in [first, last) with n[i] >= 256, 'Small' and 'Large' tell which of
+    // min(k, n - k) < 256 (log_rising_factorial minus log k!) and min(k, n - k) >= 256 (large_log_binomial) the block needs
+    template <bool Small, bool Large>
+    IMD_VECTOR_KERNEL void log_binomials_block(const unsigned long long *k, const unsigned long long *n, size_t first, size_t last, double *out) noexcept
+    {
+        constexpr unsigned long long table_size = log_factorial_table_size;
+
+        for (size_t i(first); i < last; ++i)
+        {
+            const unsigned long long kk = (k[i] < n[i] - k[i]) ? k[i] : n[i] - k[i];
+            const unsigned long long a = n[i] - kk + 1, large_k = (kk > table_size) ? kk : table_size,
+                                     large_n = (n[i] > 2 * table_size) ? n[i] : 2 * table_size;
+            const double small_value = Small ? log_rising_factorial<kernel_math>(to_double(a > table_size / 2 ? a : table_size / 2), to_double(kk)) -
+                                                   log_factorial_table[kk < table_size ? kk : table_size - 1]
+                                             : 0;
+            const double large_value = Large ? large_log_binomial<kernel_math>(to_double(large_k), to_double(large_n)) : 0;
+            out[i] = (!Large || (Small && kk < table_size)) ? small_value : large_value;
+        }
+    }
+}
+
+void IMD::log_factorials(const unsigned long long *n, size_t amount, double *out) noexcept
+{
+    IMD_PROBE_CALL(log_factorial);
+
+    constexpr unsigned long long table_size = log_factorial_table_size;
+
+    for (size_t first(0); first < amount; first += log_batch_block)
+    {
+        const size_t last = std::min(first + log_batch_block, amount);
+
+        size_t small(0);
+        for (size_t i(first); i < last; ++i)
+            small += (n[i] < table_size) ? 1 : 0;
+
+        if (small == last - first)
+            log_factorials_block<true, false>(n, first, last, out);
+        else if (small == 0)
+            log_factorials_block<false, true>(n, first, last, out);
+        else
+            log_factorials_block<true, true>(n, first, last, out);
+    }
+}
+
+void IMD::log_binomial_coefficients(const unsigned long long *k, const unsigned long long *n, size_t amount, double *out)
+{
+    IMD_PROBE_CALL(log_binomial_coefficient);
+
+    for (size_t i(0); i < amount; ++i)
+        if (k[i] > n[i])
+            throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
+
+    constexpr unsigned long long table_size = log_factorial_table_size;
+
+    for (size_t first(0); first < amount; first += log_batch_block)
+    {
+        const size_t last = std::min(first + log_batch_block, amount);
+
+        // The rows n < 256 are differences of tabulated values, the others need the series
+        size_t table_rows(0), small_k(0);
+        for (size_t i(first); i < last; ++i)
+        {
+            const unsigned long long kk = (k[i] < n[i] - k[i]) ? k[i] : n[i] - k[i];
+            table_rows += (n[i] < table_size) ? 1 : 0;
+            small_k += (n[i] >= table_size && kk < table_size) ? 1 : 0;
+        }
+
+        const size_t series = last - first - table_rows;
+        if (series != 0)
+        {
+            if (small_k == series)
+                log_binomials_block<true, false>(k, n, first, last, out);
+            else if (small_k == 0)
+                log_binomials_block<false, true>(k, n, first, last, out);
+            else
+                log_binomials_block<true, true>(k, n, first, last, out);
+        }
+        // Gathering three table values per query costs more than it saves, the lookups stay scalar
+        if (table_rows != 0)
+            for (size_t i(first); i < last; ++i)
+                if (n[i] < table_size)
+                    out[i] = log_factorial_table[n[i]] - log_factorial_table[k[i]] - log_factorial_table[n[i] - k[i]];
+    }
+}
+
+size_t IMD::Josephus_recursive_problem(size_t k, size_t n)
+{
+    IMD_PROBE_CALL(Josephus_recursive_problem);
+
+    if (n == 1)
+        return 0;
+    return (Josephus_recursive_problem(k, n - 1) + k) % n;
+}
+size_t IMD::Josephus_iterative_problem(size_t k, size_t n)
+{
+    IMD_PROBE_CALL(Josephus_iterative_problem);
+
+    size_t res(0);
+    for (size_t i(2); i <= n; ++i)
+        res = (res + k) % i;
+    return res;
+}
+
+void IMD::Hanoi_classic_recursive_problem(size_t n, char from, char to, char aux, int &moves, std::ostream &os, const char *sep)
+{
+    IMD_PROBE_CALL(Hanoi_classic_recursive_problem);
+
+    if (n == 0)
+        return;
+
+    if (n == 1)
+    {
+        {
+            IMD_PROBE_IO(Hanoi_classic_recursive_problem);
+            os << "Move the " << n << " disk from " << from << " to " << to << sep;
+        }
+        ++moves;
+        IMD_PROBE_STEPS(Hanoi_classic_recursive_problem, 1);
+        return;
+    }
+    Hanoi_classic_recursive_problem(n - 1, from, aux, to, moves, os, sep);
+    {
+        IMD_PROBE_IO(Hanoi_classic_recursive_problem);
+        os << "Move the " << n << " disk from " << from << " to " << to << sep;
+    }
+    ++moves;
+    IMD_PROBE_STEPS(Hanoi_classic_recursive_problem, 1);
+    Hanoi_classic_recursive_problem(n - 1, aux, to, from, moves, os, sep);
+}
+void IMD::Hanoi_classic_iterative_problem(size_t n, char from, char to, char aux, int &moves, std::ostream &os, const char *sep)
+{
+    IMD_PROBE_CALL(Hanoi_classic_iterative_problem);
+
+    if (n == 0)
+        return;
+
+    std::stack<std::tuple<int, char, char, char>> st; // n, from, to, aux
+    st.emplace(n, from, to, aux);
+
+    while (!st.empty())
+    {
+        auto [curr_n, curr_from, curr_to, curr_aux] = st.top();
+        st.pop();
+
+        if (curr_n == 1)
+        {
+            {
+                IMD_PROBE_IO(Hanoi_classic_iterative_problem);
+                os << "Move the " << curr_n << " disk from " << curr_from << " to " << curr_to << sep;
+            }
+            ++moves;
+            IMD_PROBE_STEPS(Hanoi_classic_iterative_problem, 1);
+        }
+        else
+        {
+            st.emplace(curr_n - 1, curr_aux, curr_to, curr_from);
+            st.emplace(1, curr_from, curr_to, curr_aux);
+            st.emplace(curr_n - 1, curr_from, curr_aux, curr_to);
+        }
+    }
+}
+void IMD::Hanoi_restricted_recursive_problem(size_t n, char from, char to, char aux, int &moves, std::ostream &os, const char *sep)
+{
+    IMD_PROBE_CALL(Hanoi_restricted_recursive_problem);
+
+    if (n == 0)
+        return;
+
+    if (n == 1)
+    {
+        {
+            IMD_PROBE_IO(Hanoi_restricted_recursive_problem);
+            os << "Move the " << n << " disk from " << from << " to " << aux << sep;
+        }
+        {
+            IMD_PROBE_IO(Hanoi_restricted_recursive_problem);
+            os << "Move the " << n << " disk from " << aux << " to " << to << sep;
+        }
+        moves += 2;
+        IMD_PROBE_STEPS(Hanoi_restricted_recursive_problem, 2);
+        return;
+    }
+
+    Hanoi_restricted_recursive_problem(n - 1, from, to, aux, moves, os, sep);
+    {
+        IMD_PROBE_IO(Hanoi_restricted_recursive_problem);
+        os << "Move the " << n << " disk from " << from << " to " << aux << sep;
+    }
+    ++moves;
+    IMD_PROBE_STEPS(Hanoi_restricted_recursive_problem, 1);
+    Hanoi_restricted_recursive_problem(n - 1, to, from, aux, moves, os, sep);
+    {
+        IMD_PROBE_IO(Hanoi_restricted_recursive_problem);
+        os << "Move the " << n << " disk from " << aux << " to " << to << sep;
+    }
+    ++moves;
+    IMD_PROBE_STEPS(Hanoi_restricted_recursive_problem, 1);
+    Hanoi_restricted_recursive_problem(n - 1, from, to, aux, moves, os, sep);
+}
+IMD::Hanoi_move IMD::Hanoi_classic_move_at(size_t n, unsigned long long index, char from, char to, char aux)
+{
+    if (n == 0 || n > 64)
+        throw std::invalid_argument("The argument 'n' is out of [1, 64]");
+    if (n < 64 && index >= (1ULL << n) - 1)
+        throw std::invalid_argument("The argument 'index' is not less than the amount of moves");
+    if (n == 64 && index == ~0ULL)
+        throw std::invalid_argument("The argument 'index' is not less than the amount of moves");
+
+    // The moves of n disks: 2^(n - 1) - 1 moves of n - 1 disks (from -> aux), the disk n (from -> to), 2^(n - 1) - 1 moves (aux -> to)
+    for (;; --n)
+    {
+        const unsigned long long middle = (1ULL << (n - 1)) - 1;
+        if (index == middle)
+            return Hanoi_move{n, from, to};
+
+        if (index < middle)
+            std::swap(to, aux);
+        else
+        {
+            index -= middle + 1;
+            std::swap(from, aux);
+        }
+    }
+}
+namespace
+{
+    // Pegs as 0, 1, 2, so the third peg of x and y is 3 - x - y
+    struct Hanoi_pegs
+    {
+        unsigned char index[256];
+
+        Hanoi_pegs(char a, char b, char c)
+        {
+            if (a == b || b == c || a == c)
+                throw std::invalid_argument("The pegs are not distinct");
+            std::fill(std::begin(this->index), std::end(this->index), 3);
+            this->index[static_cast<unsigned char>(a)] = 0;
+            this->index[static_cast<unsigned char>(b)] = 1;
+            this->index[static_cast<unsigned char>(c)] = 2;
+        }
+
+        unsigned operator()(char peg) const
+        {
+            const unsigned res = this->index[static_cast<unsigned char>(peg)];
+            if (res == 3)
+                throw std::invalid_argument("The configuration contains an unknown peg");
+            return res;
+        }
+    };
+
+    void check_Hanoi_disks(size_t n, size_t limit)
+    {
+        if (n > limit)
+            throw std::invalid_argument("The argument 'n' is too large");
+    }
+
+    // from = 0, to = 1, aux = 2
+    unsigned long long Hanoi_classic_index(const char *configuration, size_t n, const Hanoi_pegs &pegs)
+    {
+        unsigned long long res(0);
+        unsigned from(0), to(1);
+        for (size_t k(n); k > 0; --k)
+        {
+            const unsigned peg = pegs(configuration[k - 1]);
+            const unsigned aux = 3 - from - to;
+            if (peg == aux)
+                return IMD::Hanoi_off_path;
+
+            if (peg == from) // the disk k hasn't moved yet, the smaller ones go from -> aux
+                to = aux;
+            else // the disk k is done, the smaller ones go aux -> to
+            {
+                res += 1ULL << (k - 1);
+                from = aux;
+            }
+        }
+        return res;
+    }
+
+    // Moves gathering the disks [1, m] of the configuration onto 'target'
+    unsigned long long Hanoi_gather(const unsigned *configuration, size_t m, unsigned target) noexcept
+    {
+        unsigned long long res(0);
+        for (size_t k(m); k > 0; --k)
+            if (configuration[k - 1] != target)
+            {
+                res += 1ULL << (k - 1);
+                target = 3 - configuration[k - 1] - target;
+            }
+        return res;
+    }
+
+    unsigned long long Hanoi_classic_distance(const char *lhs, const char *rhs, size_t n, const Hanoi_pegs &pegs)
+    {
+        unsigned x[64], y[64];
+        for (size_t i(0); i < n; ++i)
+        {
+            x[i] = pegs(lhs[i]);
+            y[i] = pegs(rhs[i]);
+        }
+
+        // The disks above the largest different one stay
+        size_t k(n);
+        while (k > 0 && x[k - 1] == y[k - 1])
+            --k;
+        if (k == 0)
+            return 0;
+
+        const unsigned a = x[k - 1], b = y[k - 1], c = 3 - a - b;
+        // The disk k goes a -> b once, or a -> c -> b with the smaller disks moved b -> a in between
+        const unsigned long long direct = Hanoi_gather(x, k - 1, c) + 1 + Hanoi_gather(y, k - 1, c);
+        const unsigned long long detour = Hanoi_gather(x, k - 1, b) + 1 + ((1ULL << (k - 1)) - 1) + 1 + Hanoi_gather(y, k - 1, a);
+        return std::min(direct, detour);
+    }
+
+    unsigned long long Hanoi_restricted_index(const char *configuration, size_t n, const Hanoi_pegs &pegs)
+    {
+        // The disk k is on 'from' (digit 0), on aux (digit 1, the smaller ones go back to -> from) or on 'to' (digit 2)
+        unsigned long long res(0), power(1);
+        for (size_t k(1); k < n; ++k)
+            power *= 3;
+
+        unsigned from(0), to(1);
+        for (size_t k(n); k > 0; --k, power /= 3)
+        {
+            const unsigned peg = pegs(configuration[k - 1]);
+            if (peg == to)
+                res += 2 * power;
+            else if (peg != from)
+            {
+                res += power;
+                std::swap(from, to);
+            }
+        }
+        return res;
+    }
+}
+
+unsigned long long IMD::Hanoi_classic_index(const char *configuration, size_t n, char from, char to, char aux)
+{
+    IMD_PROBE_CALL(Hanoi_classic_index);
+
+    check_Hanoi_disks(n, 63);
+    return ::Hanoi_classic_index(configuration, n, Hanoi_pegs(from, to, aux));
+}
+unsigned long long IMD::Hanoi_classic_distance(const char *lhs, const char *rhs, size_t n, char a, char b, char c)
+{
+    IMD_PROBE_CALL(Hanoi_classic_distance);
+
+    check_Hanoi_disks(n, 63);
+    return ::Hanoi_classic_distance(lhs, rhs, n, Hanoi_pegs(a, b, c));
+}
+unsigned long long IMD::Hanoi_restricted_index(const char *configuration, size_t n, char from, char to, char aux)
+{
+    IMD_PROBE_CALL(Hanoi_restricted_index);
+
+    check_Hanoi_disks(n, 40);
+    return ::Hanoi_restricted_index(configuration, n, Hanoi_pegs(from, to, aux));
+}
+
+void IMD::Hanoi_classic_indices(const char *configurations, size_t n, size_t amount, unsigned long long *out, char from, char to, char aux)
+{
+    IMD_PROBE_CALL(Hanoi_classic_index);
+
+    check_Hanoi_disks(n, 63);
+    const Hanoi_pegs pegs(from, to, aux);
+    for (size_t i(0); i < amount; ++i, configurations += n)
+        out[i] = ::Hanoi_classic_index(configurations, n, pegs);
+}
+void IMD::Hanoi_classic_distances(const char *lhs, const char *rhs, size_t n, size_t amount, unsigned long long *out, char a, char b, char c)
+{
+    IMD_PROBE_CALL(Hanoi_classic_distance);
+
+    check_Hanoi_disks(n, 63);
+    const Hanoi_pegs pegs(a, b, c);
+    for (size_t i(0); i < amount; ++i, lhs += n, rhs += n)
+        out[i] = ::Hanoi_classic_distance(lhs, rhs, n, pegs);
+}
+void IMD::Hanoi_restricted_indices(const char *configurations, size_t n, size_t amount, unsigned long long *out, char from, char to, char aux)
+{
+    IMD_PROBE_CALL(Hanoi_restricted_index);
+
+    check_Hanoi_disks(n, 40);
+    const Hanoi_pegs pegs(from, to, aux);
+    for (size_t i(0); i < amount; ++i, configurations += n)
+        out[i] = ::Hanoi_restricted_index(configurations, n, pegs);
+}
+
+unsigned long long IMD::surjective_mappings_inclusion_exclusion(size_t n, size_t m)
+{
+    IMD_PROBE_CALL(surjective_mappings_inclusion_exclusion);
+
     if (m == 0)
         return (n == 0) ? 1 : 0;
     if (n < m)
         return 0;
+    // The terms wrap modulo 2^64 and so does their sum: the result is wrong only when s(n, m) itself doesn't fit
+    IMD_PROBE_OVERFLOW(surjective_mappings_inclusion_exclusion, !surjections_fit<unsigned long long>(n, m));
 
     size_t result(0);
     char sign(1);
@@ -697,6 +2709,8 @@ unsigned long long IMD::surjective_mappings_inclusion_exclusion(size_t n, size_t
 
 std::string IMD::binomial_formula(size_t n)
 {
+    IMD_PROBE_CALL(binomial_formula);
+
     if (n == 0)
         return "1";
     if (n == 1)
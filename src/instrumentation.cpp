@@ -0,0 +1,222 @@
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include "../include/combinatorics.h"
+#include "../include/instrumentation.h"
+
+namespace
+{
+    using IMD::instrumentation::function_counters;
+    using IMD::instrumentation::probes_amount;
+    using IMD::instrumentation::detail::thread_counters;
+
+    struct registry
+    {
+        std::mutex mutex;
+        std::vector<thread_counters *> alive;
+        std::array<function_counters, probes_amount> finished{}; // counters of the exited threads
+    };
+
+    registry &global_registry()
+    {
+        static registry *res = new registry; // never destroyed: threads may exit after the static destructors
+        return *res;
+    }
+
+    void accumulate(function_counters &dst, const thread_counters::slot &src) noexcept
+    {
+        dst.calls += src.calls.load(std::memory_order_relaxed);
+        dst.nanoseconds += src.nanoseconds.load(std::memory_order_relaxed);
+        dst.steps += src.steps.load(std::memory_order_relaxed);
+        dst.allocations += src.allocations.load(std::memory_order_relaxed);
+        dst.allocated_bytes += src.allocated_bytes.load(std::memory_order_relaxed);
+        dst.overflows += src.overflows.load(std::memory_order_relaxed);
+        dst.io_nanoseconds += src.io_nanoseconds.load(std::memory_order_relaxed);
+    }
+
+    const char *const probe_names[probes_amount] = {
+        "Fibonacci_goto_index",
+        "Luka_goto_index",
+        "linear_recurrence_goto_index",
+        "Fibonacci_modulo",
+        "Luka_modulo",
+        "Catalan_goto_index",
+        "Pascal_triangle",
+        "Pascal_triangle_row",
+        "Pascal_triangle_mod2",
+        "Pascal_triangle_mod3",
+        "Pascal_binomial_coefficient",
+        "iterative_binomial_coefficient",
+        "modular_binomial_coefficient",
+        "big_factorial",
+        "big_multinomial_coefficient",
+        "binomial_coefficient_128",
+        "factorial_128",
+        "surjective_mappings_128",
+        "exact_binomial_coefficient",
+        "exact_factorial",
+        "exact_surjective_mappings",
+        "Josephus_recursive_problem",
+        "Josephus_iterative_problem",
+        "Hanoi_classic_recursive_problem",
+        "Hanoi_classic_iterative_problem",
+        "Hanoi_restricted_recursive_problem",
+        "Hanoi_classic_index",
+        "Hanoi_classic_distance",
+        "Hanoi_restricted_index",
+        "surjective_mappings_inclusion_exclusion",
+        "binomial_formula",
+        "log_factorial",
+        "log_binomial_coefficient",
+        "log_multinomial_coefficient",
+        "precomputed_table",
+        "k_subset",
+        "permutation",
+        "Dyck_path",
+        "surjection",
+    };
+}
+
+IMD::instrumentation::detail::thread_counters::thread_counters()
+{
+    registry &reg = global_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.alive.push_back(this);
+}
+
+IMD::instrumentation::detail::thread_counters::~thread_counters()
+{
+    registry &reg = global_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (size_t i(0); i < probes_amount; ++i)
+        accumulate(reg.finished[i], this->slots[i]);
+    reg.alive.erase(std::find(reg.alive.begin(), reg.alive.end(), this));
+}
+
+IMD::instrumentation::detail::thread_counters &IMD::instrumentation::detail::local() noexcept
+{
+    thread_local thread_counters counters;
+    return counters;
+}
+
+const char *IMD::instrumentation::probe_name(probe p) noexcept
+{
+    const size_t index = static_cast<size_t>(p);
+    return index < probes_amount ? probe_names[index] : "unknown";
+}
+
+const IMD::instrumentation::function_counters &IMD::instrumentation::snapshot::operator[](probe p) const noexcept
+{
+    return this->functions[static_cast<size_t>(p)];
+}
+
+IMD::instrumentation::snapshot IMD::instrumentation::take_snapshot()
+{
+    snapshot res;
+    if (!enabled())
+        return res;
+
+    registry &reg = global_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    res.functions = reg.finished;
+    for (const thread_counters *counters : reg.alive)
+        for (size_t i(0); i < probes_amount; ++i)
+            accumulate(res.functions[i], counters->slots[i]);
+    return res;
+}
+
+// Warning: increments made by other threads at the same moment may survive the reset
+void IMD::instrumentation::reset()
+{
+    registry &reg = global_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.finished = {};
+    for (thread_counters *counters : reg.alive)
+        for (thread_counters::slot &slot : counters->slots)
+        {
+            slot.calls.store(0, std::memory_order_relaxed);
+            slot.nanoseconds.store(0, std::memory_order_relaxed);
+            slot.steps.store(0, std::memory_order_relaxed);
+            slot.allocations.store(0, std::memory_order_relaxed);
+            slot.allocated_bytes.store(0, std::memory_order_relaxed);
+            slot.overflows.store(0, std::memory_order_relaxed);
+            slot.io_nanoseconds.store(0, std::memory_order_relaxed);
+        }
+}
+
+void IMD::instrumentation::dump_json(std::ostream &os, const snapshot &snap)
+{
+    os << "{\"enabled\":" << (enabled() ? "true" : "false") << ",\"functions\":{";
+    for (size_t i(0); i < probes_amount; ++i)
+    {
+        const function_counters &c = snap.functions[i];
+        if (i > 0)
+            os << ',';
+        os << '"' << probe_names[i] << "\":{"
+           << "\"calls\":" << c.calls
+           << ",\"nanoseconds\":" << c.nanoseconds
+           << ",\"steps\":" << c.steps
+           << ",\"allocations\":" << c.allocations
+           << ",\"allocated_bytes\":" << c.allocated_bytes
+           << ",\"overflows\":" << c.overflows
+           << ",\"io_nanoseconds\":" << c.io_nanoseconds
+           << '}';
+    }
+    os << "}}";
+}
+
+std::string IMD::instrumentation::to_json(const snapshot &snap)
+{
+    std::ostringstream oss;
+    dump_json(oss, snap);
+    return oss.str();
+}
+
+#ifdef IMD_COMBINATORICS_INSTRUMENTATION
+namespace
+{
+    IMD::instrumentation::probe probe_of(IMD::instrumentation::recurrence_probe p) noexcept
+    {
+        switch (p)
+        {
+        case IMD::instrumentation::recurrence_probe::Fibonacci:
+            return IMD::instrumentation::probe::Fibonacci_goto_index;
+        case IMD::instrumentation::recurrence_probe::Luka:
+            return IMD::instrumentation::probe::Luka_goto_index;
+        default:
+            return IMD::instrumentation::probe::linear_recurrence_goto_index;
+        }
+    }
+}
+#endif
+
+// The same bookkeeping as detail::scoped_call, split in two so that the header template only calls these functions
+std::uint64_t IMD::instrumentation::recurrence_enter(recurrence_probe p) noexcept
+{
+#ifdef IMD_COMBINATORICS_INSTRUMENTATION
+    detail::thread_counters::slot &slot = detail::slot_of(probe_of(p));
+    return (slot.depth++ == 0) ? detail::now() : 0;
+#else
+    (void)p;
+    return 0;
+#endif
+}
+
+void IMD::instrumentation::recurrence_leave(recurrence_probe p, std::uint64_t start, std::uint64_t steps, bool overflow) noexcept
+{
+#ifdef IMD_COMBINATORICS_INSTRUMENTATION
+    detail::thread_counters::slot &slot = detail::slot_of(probe_of(p));
+    if (steps != 0)
+        detail::bump(slot.steps, steps);
+    if (overflow)
+        detail::bump(slot.overflows, 1);
+    if (--slot.depth == 0)
+    {
+        detail::bump(slot.calls, 1);
+        detail::bump(slot.nanoseconds, detail::now() - start);
+    }
+#else
+    (void)p, (void)start, (void)steps, (void)overflow;
+#endif
+}
@@ -1,9 +1,557 @@
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <charconv>
+#include <stdexcept>
+#include <cmath>
 #include "../include/combinatorics.h"
+#include "../include/tables.h"
 
-int main()
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Batch query engine: reads queries from stdin or a file, evaluates them on a worker pool and writes the results in order.
+//
+// Usage: combinatorics [--binary] [--threads N] [--chunk N] [--tables DIR] [FILE]
+//
+// Text queries, one per line (the modulus is optional):
+//   binomial k n [m]   Catalan n [m]   Fibonacci n [m]   Josephus k n   surjection n m   Hanoi n index
+// Every result is written on its own line, invalid queries produce "error: <reason>". Binomials and surjections without
+// a modulus are exact at any size (64 bits, 128 bits or arbitrary precision) up to 100000 decimal digits (max_wide_digits),
+// larger ones are rejected before any work. Every prime power of a modulus has to be at most 2^22
+// (binomial_modulo_solver::max_table_modulus), e.g. 10^9 + 7 is rejected.
+//
+// Binary queries are records of 32 bytes (native endianness): u32 kind (1 binomial, 2 Catalan, 3 Fibonacci,
+// 4 Josephus, 5 surjection, 6 Hanoi), u32 has_modulus, u64 a, u64 b, u64 modulus with the arguments in the order above.
+// Every result is an u64, Hanoi moves are packed as disk << 16 | from << 8 | to, errors (and results past 64 bits) are 2^64 - 1.
+namespace
 {
-    std::cout << IMD::binomial_formula(5) << std::endl;
-    std::cout << "Hello, world!" << std::endl;
+    enum class query_kind : std::uint32_t
+    {
+        binomial = 1,
+        Catalan = 2,
+        Fibonacci = 3,
+        Josephus = 4,
+        surjection = 5,
+        Hanoi = 6
+    };
+
+    struct query
+    {
+        std::uint32_t kind;
+        std::uint32_t has_modulus;
+        std::uint64_t a, b, modulus;
+    };
+    static_assert(sizeof(query) == 32, "The binary record has to be 32 bytes");
+
+    constexpr std::uint64_t binary_error = ~std::uint64_t(0);
+
+    // Exact values fitting into 64 bits, shared read only by all workers
+    struct shared_tables
+    {
+        IMD::precomputed_table Pascal, Catalan, Fibonacci;
+    };
+
+    shared_tables load_tables(const std::string &dir)
+    {
+        using kind = IMD::precomputed_table::kind;
+        auto load = [&](const char *name, kind k, std::uint64_t size)
+        {
+            return dir.empty() ? IMD::precomputed_table::compute(k, size, 0)
+                               : IMD::precomputed_table::open_or_compute(dir + "/" + name, k, size, 0);
+        };
+        return shared_tables{load("Pascal.tbl", kind::Pascal_triangle, 68),
+                             load("Catalan.tbl", kind::Catalan_numbers, 37),
+                             load("Fibonacci.tbl", kind::Fibonacci_numbers, 94)};
+    }
+
+    // Input bytes, mapped from a file or read from stdin
+    class input_buffer
+    {
+    private:
+        std::vector<char> __storage;
+        const char *__data = nullptr;
+        size_t __size = 0;
+        void *__mapping = nullptr;
+
+    public:
+        input_buffer() = default;
+        input_buffer(const input_buffer &) = delete;
+        input_buffer &operator=(const input_buffer &) = delete;
+        ~input_buffer()
+        {
+#ifndef _WIN32
+            if (this->__mapping != nullptr)
+                munmap(this->__mapping, this->__size);
+#endif
+        }
+
+        void read_stdin()
+        {
+            constexpr size_t block = 1 << 20;
+            size_t got(0);
+            do
+            {
+                this->__storage.resize(this->__storage.size() + block);
+                got = std::fread(this->__storage.data() + this->__storage.size() - block, 1, block, stdin);
+                this->__storage.resize(this->__storage.size() - block + got);
+            } while (got == block);
+
+            this->__data = this->__storage.data();
+            this->__size = this->__storage.size();
+        }
+
+        void map_file(const std::string &path)
+        {
+#ifndef _WIN32
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("Can't open '" + path + "'");
+
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+            {
+                ::close(fd);
+                throw std::runtime_error("Can't read '" + path + "'");
+            }
+            this->__size = static_cast<size_t>(info.st_size);
+            if (this->__size > 0)
+            {
+                this->__mapping = mmap(nullptr, this->__size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (this->__mapping == MAP_FAILED)
+                {
+                    this->__mapping = nullptr;
+                    ::close(fd);
+                    throw std::runtime_error("Can't map '" + path + "'");
+                }
+                madvise(this->__mapping, this->__size, MADV_SEQUENTIAL);
+                this->__data = static_cast<const char *>(this->__mapping);
+            }
+            ::close(fd);
+#else
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                throw std::runtime_error("Can't open '" + path + "'");
+            this->__storage.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            this->__data = this->__storage.data();
+            this->__size = this->__storage.size();
+#endif
+        }
+
+        const char *data() const noexcept { return this->__data; }
+        size_t size() const noexcept { return this->__size; }
+    };
+
+    bool parse_number(const char *&first, const char *last, std::uint64_t &value) noexcept
+    {
+        while (first != last && (*first == ' ' || *first == '\t'))
+            ++first;
+        const auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc() || ptr == first)
+            return false;
+        first = ptr;
+        return true;
+    }
+
+    // Returns nullptr on success, otherwise the reason of the failure
+    const char *parse_line(const char *first, const char *last, query &q) noexcept
+    {
+        while (first != last && (*first == ' ' || *first == '\t'))
+            ++first;
+        const char *name = first;
+        while (first != last && *first != ' ' && *first != '\t')
+            ++first;
+        const std::string_view word(name, first - name);
+
+        size_t arguments;
+        if (word == "binomial")
+            q.kind = static_cast<std::uint32_t>(query_kind::binomial), arguments = 2;
+        else if (word == "Catalan" || word == "catalan")
+            q.kind = static_cast<std::uint32_t>(query_kind::Catalan), arguments = 1;
+        else if (word == "Fibonacci" || word == "fibonacci")
+            q.kind = static_cast<std::uint32_t>(query_kind::Fibonacci), arguments = 1;
+        else if (word == "Josephus" || word == "josephus")
+            q.kind = static_cast<std::uint32_t>(query_kind::Josephus), arguments = 2;
+        else if (word == "surjection")
+            q.kind = static_cast<std::uint32_t>(query_kind::surjection), arguments = 2;
+        else if (word == "Hanoi" || word == "hanoi")
+            q.kind = static_cast<std::uint32_t>(query_kind::Hanoi), arguments = 2;
+        else
+            return "unknown query";
+
+        q.b = 0;
+        if (!parse_number(first, last, q.a) || (arguments == 2 && !parse_number(first, last, q.b)))
+            return "invalid arguments";
+
+        // The optional modulus of binomial, Catalan and Fibonacci
+        q.has_modulus = 0;
+        if (q.kind == static_cast<std::uint32_t>(query_kind::binomial) || arguments == 1)
+            q.has_modulus = parse_number(first, last, q.modulus) ? 1 : 0;
+
+        while (first != last && (*first == ' ' || *first == '\t' || *first == '\r'))
+            ++first;
+        return first == last ? nullptr : "unexpected trailing characters";
+    }
+
+    // Binomials past the Pascal table without a modulus and surjections may not fit into 64 bits
+    bool is_wide(const query &q, const shared_tables &tables)
+    {
+        if (q.kind == static_cast<std::uint32_t>(query_kind::surjection))
+            return true;
+        return q.kind == static_cast<std::uint32_t>(query_kind::binomial) && !q.has_modulus && q.a <= q.b &&
+               q.b >= tables.Pascal.size();
+    }
+
+    // Wide results are bounded, so a single query can't hold a worker (and its memory) for long
+    constexpr double max_wide_digits = 100000;
+
+    // Upper bound of the decimal digits of a wide query: log C(n, k) and surj(n, m) = m! S(n, m) <= n! / (n - m)! * m^(n - m)
+    double wide_digits(const query &q)
+    {
+        double log_value(0);
+        if (q.kind == static_cast<std::uint32_t>(query_kind::binomial))
+            log_value = IMD::log_binomial_coefficient(q.a, q.b);
+        else if (q.b != 0 && q.a >= q.b)
+            log_value = IMD::log_factorial(q.a) - IMD::log_factorial(q.a - q.b) + (q.a - q.b) * std::log(static_cast<double>(q.b));
+        return log_value / std::log(10.0) + 1;
+    }
+
+    // The exact value of a wide query in decimal, 'fits' tells whether it fits into 64 bits (then it is also in 'value')
+    std::string wide_value(const query &q, bool &fits, std::uint64_t &value)
+    {
+        if (wide_digits(q) > max_wide_digits)
+            throw std::invalid_argument("the value has more than 100000 digits, pass a modulus");
+
+#ifdef __SIZEOF_INT128__
+        const IMD::exact_unsigned res = (q.kind == static_cast<std::uint32_t>(query_kind::binomial))
+                                            ? IMD::exact_binomial_coefficient(q.a, q.b)
+                                            : IMD::exact_surjective_mappings(q.a, q.b);
+        fits = res.width == IMD::exact_unsigned::width_type::bits_64;
+        value = static_cast<std::uint64_t>(res.value);
+        return res.to_string();
+#else
+        if (q.kind == static_cast<std::uint32_t>(query_kind::binomial))
+        {
+            const IMD::big_unsigned res = IMD::big_multinomial_coefficient({q.a, q.b - q.a});
+            fits = res.bits() <= 64;
+            value = 0;
+            for (size_t i(std::min<size_t>(res.limbs().size(), 2)); i > 0; --i)
+                value = (value << 32) | res.limbs()[i - 1];
+            return res.to_string();
+        }
+        // m^n bounds the amount of surjections, below 2^64 the inclusion-exclusion doesn't wrap
+        if (q.b > 1 && q.a * std::log2(static_cast<double>(q.b)) >= 64)
+            throw std::invalid_argument("the value doesn't fit into 64 bits, pass a modulus");
+        fits = true;
+        value = IMD::surjective_mappings_inclusion_exclusion(q.a, q.b);
+        return std::to_string(value);
+#endif
+    }
+
+    // The value of the query, Hanoi moves are packed as disk << 16 | from << 8 | to
+    std::uint64_t evaluate(const query &q, const shared_tables &tables)
+    {
+        if (is_wide(q, tables))
+        {
+            bool fits;
+            std::uint64_t value;
+            wide_value(q, fits, value);
+            if (!fits)
+                throw std::invalid_argument("the value doesn't fit into 64 bits, pass a modulus");
+            return value;
+        }
+
+        switch (static_cast<query_kind>(q.kind))
+        {
+        case query_kind::binomial:
+            if (q.a > q.b)
+                throw std::invalid_argument("k is more than n");
+            if (q.has_modulus)
+                return IMD::modular_binomial_coefficient(q.a, q.b, q.modulus);
+            return tables.Pascal.binomial(q.a, q.b);
+
+        case query_kind::Catalan:
+            if (q.has_modulus)
+            {
+                // C_n = C(2n, n) - C(2n, n + 1)
+                if (q.modulus == 0)
+                    throw std::invalid_argument("zero modulus");
+                if (q.a == 0)
+                    return 1 % q.modulus;
+                if (q.a > SIZE_MAX / 2 - 1)
+                    throw std::invalid_argument("n is out of range");
+                const std::uint64_t lhs = IMD::modular_binomial_coefficient(q.a, 2 * q.a, q.modulus);
+                const std::uint64_t rhs = IMD::modular_binomial_coefficient(q.a + 1, 2 * q.a, q.modulus);
+                return lhs >= rhs ? lhs - rhs : q.modulus - (rhs - lhs);
+            }
+            if (q.a >= tables.Catalan.size())
+                throw std::invalid_argument("the value doesn't fit into 64 bits, pass a modulus");
+            return tables.Catalan[q.a];
+
+        case query_kind::Fibonacci:
+            if (q.has_modulus)
+                return IMD::Fibonacci_modulo(q.a, q.modulus);
+            if (q.a >= tables.Fibonacci.size())
+                throw std::invalid_argument("the value doesn't fit into 64 bits, pass a modulus");
+            return tables.Fibonacci[q.a];
+
+        case query_kind::Josephus:
+            if (q.b == 0)
+                throw std::invalid_argument("n is zero");
+            return IMD::Josephus_iterative_problem(q.a, q.b);
+
+        case query_kind::surjection: // always wide
+            break;
+
+        case query_kind::Hanoi:
+        {
+            const IMD::Hanoi_move move = IMD::Hanoi_classic_move_at(q.a, q.b);
+            return (std::uint64_t(move.disk) << 16) | (std::uint64_t(std::uint8_t(move.from)) << 8) | std::uint8_t(move.to);
+        }
+        }
+        throw std::invalid_argument("unknown query");
+    }
+
+    void append_number(std::string &out, std::uint64_t value)
+    {
+        char buffer[24];
+        const auto res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, res.ptr);
+    }
+
+    void append_text_result(std::string &out, const query &q, std::uint64_t value)
+    {
+        if (q.kind == static_cast<std::uint32_t>(query_kind::Hanoi))
+        {
+            append_number(out, value >> 16);
+            out += ' ';
+            out += static_cast<char>((value >> 8) & 0xFF);
+            out += ' ';
+            out += static_cast<char>(value & 0xFF);
+        }
+        else
+            append_number(out, value);
+        out += '\n';
+    }
+
+    struct statistics
+    {
+        std::atomic<std::uint64_t> queries{0}, errors{0};
+    };
+
+    // Text input: a chunk is a range of lines, the result is the text for these lines
+    using line_type = std::pair<const char *, const char *>; // without '\n'
+
+    void process_text_chunk(const std::vector<line_type> &lines, size_t first, size_t last,
+                            const shared_tables &tables, std::string &out, statistics &stats)
+    {
+        std::uint64_t errors(0);
+        out.reserve(16 * (last - first));
+        for (size_t i(first); i < last; ++i)
+        {
+            query q;
+            const char *failure = parse_line(lines[i].first, lines[i].second, q);
+            if (failure != nullptr)
+            {
+                out += "error: ";
+                out += failure;
+                out += '\n';
+                ++errors;
+                continue;
+            }
+
+            try
+            {
+                if (is_wide(q, tables))
+                {
+                    bool fits;
+                    std::uint64_t value;
+                    out += wide_value(q, fits, value);
+                    out += '\n';
+                }
+                else
+                    append_text_result(out, q, evaluate(q, tables));
+            }
+            catch (const std::exception &e)
+            {
+                out += "error: ";
+                out += e.what();
+                out += '\n';
+                ++errors;
+            }
+        }
+        stats.queries += last - first;
+        stats.errors += errors;
+    }
+
+    void process_binary_chunk(const query *queries, size_t first, size_t last,
+                              const shared_tables &tables, std::string &out, statistics &stats)
+    {
+        std::uint64_t errors(0);
+        out.resize((last - first) * sizeof(std::uint64_t));
+        char *dst = &out[0];
+        for (size_t i(first); i < last; ++i, dst += sizeof(std::uint64_t))
+        {
+            query q;
+            std::memcpy(&q, queries + i, sizeof(q)); // the input may be unaligned
+            std::uint64_t value;
+            try
+            {
+                value = evaluate(q, tables);
+            }
+            catch (const std::exception &)
+            {
+                value = binary_error;
+                ++errors;
+            }
+            std::memcpy(dst, &value, sizeof(value));
+        }
+        stats.queries += last - first;
+        stats.errors += errors;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool binary(false);
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t chunk_size(4096);
+    std::string tables_dir, path;
+
+    for (int i(1); i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        if (arg == "--binary")
+            binary = true;
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        else if (arg == "--chunk" && i + 1 < argc)
+            chunk_size = std::max<size_t>(1, std::stoul(argv[++i]));
+        else if (arg == "--tables" && i + 1 < argc)
+            tables_dir = argv[++i];
+        else if (arg == "--help" || arg == "-h" || (!arg.empty() && arg[0] == '-'))
+        {
+            std::cerr << "Usage: " << argv[0] << " [--binary] [--threads N] [--chunk N] [--tables DIR] [FILE]" << std::endl;
+            return arg == "--help" || arg == "-h" ? 0 : 2;
+        }
+        else
+            path = arg;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    input_buffer input;
+    shared_tables tables = load_tables(tables_dir);
+    try
+    {
+        if (path.empty())
+            input.read_stdin();
+        else
+            input.map_file(path);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // Split the input into queries
+    std::vector<line_type> lines; // text input only
+    size_t amount(0);
+    if (binary)
+    {
+        if (input.size() % sizeof(query) != 0)
+        {
+            std::cerr << "The binary input isn't a whole number of " << sizeof(query) << " byte records" << std::endl;
+            return 1;
+        }
+        amount = input.size() / sizeof(query);
+    }
+    else
+    {
+        const char *curr = input.data(), *end = input.data() + input.size();
+        while (curr != end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(curr, '\n', end - curr));
+            const char *line_end = (newline == nullptr) ? end : newline;
+            if (line_end != curr && !(line_end - curr == 1 && *curr == '\r')) // skip the empty lines
+                lines.emplace_back(curr, line_end);
+            curr = (newline == nullptr) ? end : newline + 1;
+        }
+        amount = lines.size();
+    }
+
+    const size_t chunks = (amount + chunk_size - 1) / chunk_size;
+    std::vector<std::string> results(chunks);
+    std::unique_ptr<std::atomic<bool>[]> ready(new std::atomic<bool>[chunks]);
+    for (size_t i(0); i < chunks; ++i)
+        ready[i] = false;
+
+    std::atomic<size_t> next_chunk(0);
+    std::mutex mutex;
+    std::condition_variable chunk_ready;
+    statistics stats;
+
+    auto worker = [&]()
+    {
+        for (size_t c; (c = next_chunk.fetch_add(1)) < chunks;)
+        {
+            const size_t first = c * chunk_size, last = std::min(amount, first + chunk_size);
+            if (binary)
+                process_binary_chunk(reinterpret_cast<const query *>(input.data()), first, last, tables, results[c], stats);
+            else
+                process_text_chunk(lines, first, last, tables, results[c], stats);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready[c] = true;
+            }
+            chunk_ready.notify_one();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i(0); i < threads; ++i)
+        pool.emplace_back(worker);
+
+    // Stream the chunks in order as soon as they are ready
+    static char output_buffer[1 << 20];
+    std::setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+    std::uint64_t written(0);
+    for (size_t c(0); c < chunks; ++c)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            chunk_ready.wait(lock, [&]
+                             { return ready[c].load(); });
+        }
+        std::fwrite(results[c].data(), 1, results[c].size(), stdout);
+        written += results[c].size();
+        std::string().swap(results[c]);
+    }
+    std::fflush(stdout);
+
+    for (std::thread &t : pool)
+        t.join();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "queries: " << stats.queries << ", errors: " << stats.errors
+              << ", threads: " << threads
+              << ", time: " << seconds << " s"
+              << ", throughput: " << (seconds > 0 ? stats.queries / seconds : 0.0) << " queries/s"
+              << ", input: " << input.size() << " bytes, output: " << written << " bytes" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
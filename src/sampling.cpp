@@ -0,0 +1,422 @@
+#include <stdexcept>
+#include <cmath>
+#include <limits>
+#include "../include/sampling.h"
+#include "../include/instrumentation.h"
+
+namespace
+{
+    // The elements of [0, n) have to fit into combinatorial_sampler::element_type
+    constexpr std::uint64_t element_limit = std::uint64_t(std::numeric_limits<IMD::combinatorial_sampler::element_type>::max()) + 1;
+
+    std::uint64_t splitmix64(std::uint64_t &state) noexcept
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t rotate_left(std::uint64_t x, int k) noexcept
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    // The full 128-bit product of a and b
+    void multiply_full(std::uint64_t a, std::uint64_t b, std::uint64_t &high, std::uint64_t &low) noexcept
+    {
+#ifdef __SIZEOF_INT128__
+        const unsigned __int128 prod = static_cast<unsigned __int128>(a) * b;
+        high = static_cast<std::uint64_t>(prod >> 64);
+        low = static_cast<std::uint64_t>(prod);
+#else
+        const std::uint64_t a_lo = a & 0xFFFFFFFFULL, a_hi = a >> 32, b_lo = b & 0xFFFFFFFFULL, b_hi = b >> 32;
+        const std::uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+        const std::uint64_t middle = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+        high = hi_hi + (hi_lo >> 32) + (middle >> 32);
+        low = (middle << 32) | (lo_lo & 0xFFFFFFFFULL);
+#endif
+    }
+
+    double uniform_unit(IMD::xoshiro256_plus_plus &generator) noexcept
+    {
+        return static_cast<double>(generator() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // log(exp(a) + exp(b))
+    double log_add(double a, double b) noexcept
+    {
+        if (a < b)
+            std::swap(a, b);
+        if (b == -std::numeric_limits<double>::infinity())
+            return a;
+        return a + std::log1p(std::exp(b - a));
+    }
+}
+
+IMD::xoshiro256_plus_plus::xoshiro256_plus_plus(std::uint64_t seed) noexcept
+{
+    for (std::uint64_t &s : this->__state)
+        s = splitmix64(seed);
+}
+
+IMD::xoshiro256_plus_plus::result_type IMD::xoshiro256_plus_plus::operator()() noexcept
+{
+    std::uint64_t *s = this->__state;
+    const std::uint64_t res = rotate_left(s[0] + s[3], 23) + s[0];
+    const std::uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_left(s[3], 45);
+    return res;
+}
+
+void IMD::xoshiro256_plus_plus::jump() noexcept
+{
+    static constexpr std::uint64_t polynomial[] = {0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL};
+
+    std::uint64_t s[4] = {0, 0, 0, 0};
+    for (std::uint64_t word : polynomial)
+        for (int b(0); b < 64; ++b)
+        {
+            if (word & (std::uint64_t(1) << b))
+                for (int i(0); i < 4; ++i)
+                    s[i] ^= this->__state[i];
+            this->operator()();
+        }
+
+    for (int i(0); i < 4; ++i)
+        this->__state[i] = s[i];
+}
+
+IMD::xoshiro256_plus_plus IMD::xoshiro256_plus_plus::stream(std::uint64_t seed, size_t index) noexcept
+{
+    xoshiro256_plus_plus res(seed);
+    for (size_t i(0); i < index; ++i)
+        res.jump();
+    return res;
+}
+
+IMD::combinatorial_sampler::combinatorial_sampler(std::uint64_t seed, size_t stream)
+    : __generator(xoshiro256_plus_plus::stream(seed, stream)), __Stirling_n(0), __Stirling_m(0) {}
+
+IMD::combinatorial_sampler::combinatorial_sampler(const combinatorial_sampler &other)
+    : __generator(other.__generator), __scratch(other.__scratch), __Stirling(other.__Stirling),
+      __Stirling_n(other.__Stirling_n), __Stirling_m(other.__Stirling_m), __labels(other.__labels), __steps(other.__steps) {}
+
+IMD::combinatorial_sampler::combinatorial_sampler(combinatorial_sampler &&other) noexcept
+    : __generator(std::move(other.__generator)), __scratch(std::move(other.__scratch)), __Stirling(std::move(other.__Stirling)),
+      __Stirling_n(std::move(other.__Stirling_n)), __Stirling_m(std::move(other.__Stirling_m)), __labels(std::move(other.__labels)),
+      __steps(std::move(other.__steps)) {}
+
+IMD::combinatorial_sampler &IMD::combinatorial_sampler::operator=(const combinatorial_sampler &other)
+{
+    if (this != &other)
+    {
+        this->__generator = other.__generator;
+        this->__scratch = other.__scratch;
+        this->__Stirling = other.__Stirling;
+        this->__Stirling_n = other.__Stirling_n;
+        this->__Stirling_m = other.__Stirling_m;
+        this->__labels = other.__labels;
+        this->__steps = other.__steps;
+    }
+    return *this;
+}
+
+IMD::combinatorial_sampler &IMD::combinatorial_sampler::operator=(combinatorial_sampler &&other) noexcept
+{
+    this->__generator = std::move(other.__generator);
+    this->__scratch = std::move(other.__scratch);
+    this->__Stirling = std::move(other.__Stirling);
+    this->__Stirling_n = std::move(other.__Stirling_n);
+    this->__Stirling_m = std::move(other.__Stirling_m);
+    this->__labels = std::move(other.__labels);
+    this->__steps = std::move(other.__steps);
+    return *this;
+}
+
+IMD::xoshiro256_plus_plus &IMD::combinatorial_sampler::generator() noexcept
+{
+    return this->__generator;
+}
+
+std::uint64_t IMD::combinatorial_sampler::bounded(std::uint64_t bound) noexcept
+{
+    std::uint64_t high, low;
+    multiply_full(this->__generator(), bound, high, low);
+    if (low < bound)
+    {
+        const std::uint64_t threshold = (0 - bound) % bound;
+        while (low < threshold)
+            multiply_full(this->__generator(), bound, high, low);
+    }
+    return high;
+}
+
+void IMD::combinatorial_sampler::k_subset(size_t n, size_t k, element_type *out)
+{
+    IMD_PROBE_CALL(k_subset);
+
+    if (k > n)
+        throw std::invalid_argument("The argument 'k' is more than the argument 'n'");
+    if (n > element_limit)
+        throw std::invalid_argument("The argument 'n' is more than 2^32");
+
+    // Floyd: for j in [n - k, n) take a random t in [0, j], if t is already taken, take j instead
+    if (n <= 16 * k)
+    {
+        // Dense: bitmap of n bits, only the set bits are cleared afterwards
+        if (this->__scratch.size() < n / 64 + 1)
+        {
+            IMD_PROBE_ALLOCATION(k_subset, (n / 64 + 1) * sizeof(std::uint64_t));
+            this->__scratch.resize(n / 64 + 1, 0);
+        }
+        std::uint64_t *bits = this->__scratch.data();
+
+        for (size_t i(0), j(n - k); j < n; ++i, ++j)
+        {
+            size_t t = this->bounded(j + 1);
+            if (bits[t / 64] & (std::uint64_t(1) << (t % 64)))
+                t = j;
+            bits[t / 64] |= std::uint64_t(1) << (t % 64);
+            out[i] = static_cast<element_type>(t);
+        }
+        for (size_t i(0); i < k; ++i)
+            bits[out[i] / 64] = 0;
+        return;
+    }
+
+    // Sparse: open addressing table of at least 2k slots, an empty slot is 0, the others keep value + 1.
+    // The slot is the top log2(capacity) bits of the Fibonacci hash
+    size_t capacity(16), shift(60);
+    while (capacity < 2 * k)
+    {
+        capacity <<= 1;
+        --shift;
+    }
+    if (this->__scratch.size() < capacity)
+    {
+        IMD_PROBE_ALLOCATION(k_subset, capacity * sizeof(std::uint64_t));
+        this->__scratch.resize(capacity, 0);
+    }
+    std::uint64_t *table = this->__scratch.data();
+    const size_t mask = capacity - 1;
+
+    auto insert = [&](std::uint64_t value) noexcept
+    {
+        size_t slot = (value * 0x9E3779B97F4A7C15ULL) >> shift;
+        while (table[slot] != 0)
+        {
+            if (table[slot] == value + 1)
+                return false;
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = value + 1;
+        return true;
+    };
+
+    for (size_t i(0), j(n - k); j < n; ++i, ++j)
+    {
+        const std::uint64_t t = this->bounded(j + 1);
+        out[i] = static_cast<element_type>(insert(t) ? t : (insert(j), j));
+    }
+    std::fill(table, table + capacity, 0);
+}
+
+void IMD::combinatorial_sampler::permutation(size_t n, element_type *out)
+{
+    IMD_PROBE_CALL(permutation);
+
+    if (n > element_limit)
+        throw std::invalid_argument("The argument 'n' is more than 2^32");
+
+    for (size_t i(0); i < n; ++i)
+        out[i] = static_cast<element_type>(i);
+
+    // Batched dice rolls (Brackett-Rozinsky, Lemire): one 64-bit word gives the indices for the bounds i + 1 and i,
+    // i (i - 1) fits into 64 bits for i <= 2^32
+    size_t i(n);
+    while (i > 2)
+    {
+        const std::uint64_t b1 = i, b2 = i - 1, product = b1 * b2;
+        std::uint64_t first, second, low;
+
+        multiply_full(this->__generator(), b1, first, low);
+        multiply_full(low, b2, second, low);
+        if (low < product)
+        {
+            const std::uint64_t threshold = (0 - product) % product;
+            while (low < threshold)
+            {
+                multiply_full(this->__generator(), b1, first, low);
+                multiply_full(low, b2, second, low);
+            }
+        }
+
+        std::swap(out[i - 1], out[first]);
+        std::swap(out[i - 2], out[second]);
+        i -= 2;
+    }
+    if (i == 2)
+        std::swap(out[1], out[this->bounded(2)]);
+}
+
+void IMD::combinatorial_sampler::Dyck_path(size_t n, unsigned char *out)
+{
+    IMD_PROBE_CALL(Dyck_path);
+
+    if (n == 0)
+        return;
+
+    // A random arrangement of n ups and n + 1 downs
+    const size_t length = 2 * n + 1;
+    if (this->__steps.capacity() < length)
+        IMD_PROBE_ALLOCATION(Dyck_path, length);
+    this->__steps.resize(length);
+    unsigned char *steps = this->__steps.data();
+    std::fill(steps, steps + n, 1);
+    std::fill(steps + n, steps + length, 0);
+    for (size_t i(length); i > 1; --i)
+        std::swap(steps[i - 1], steps[this->bounded(i)]);
+
+    // Cycle lemma: exactly one rotation keeps all proper prefix sums non-negative,
+    // it starts right after the first minimum of the prefix sums
+    long long sum(0), minimum(0);
+    size_t start(0);
+    for (size_t i(0); i < length; ++i)
+    {
+        sum += steps[i] ? 1 : -1;
+        if (sum < minimum)
+        {
+            minimum = sum;
+            start = i + 1;
+        }
+    }
+
+    // The total is -1, so start > 0 and the last step of the rotation, steps[start - 1], is a down: it is dropped
+    std::copy(steps + start, steps + length, out);
+    std::copy(steps, steps + start - 1, out + (length - start));
+}
+
+void IMD::combinatorial_sampler::prepare_Stirling(size_t n, size_t m)
+{
+    if (this->__Stirling_n == n && this->__Stirling_m == m && !this->__Stirling.empty())
+        return;
+
+    // log S(i, j), S(i, j) = S(i - 1, j - 1) + j * S(i - 1, j): (n + 1)(m + 1) doubles and as many logarithms, the walk
+    // of surjection goes down from row n and needs every row, so the table is kept while n and m repeat
+    const double minus_infinity = -std::numeric_limits<double>::infinity();
+    const size_t width = m + 1;
+    if (n + 1 > this->__Stirling.max_size() / width)
+        throw std::length_error("The table of the Stirling numbers is too large");
+    if (this->__Stirling.capacity() < (n + 1) * width)
+        IMD_PROBE_ALLOCATION(surjection, (n + 1) * width * sizeof(double));
+    this->__Stirling.assign((n + 1) * width, minus_infinity);
+    double *S = this->__Stirling.data();
+
+    S[0] = 0;
+    for (size_t i(1); i <= n; ++i)
+        for (size_t j(1); j <= std::min(i, m); ++j)
+            S[i * width + j] = log_add(S[(i - 1) * width + j - 1], std::log(static_cast<double>(j)) + S[(i - 1) * width + j]);
+
+    this->__Stirling_n = n;
+    this->__Stirling_m = m;
+}
+
+void IMD::combinatorial_sampler::surjection(size_t n, size_t m, element_type *out)
+{
+    IMD_PROBE_CALL(surjection);
+
+    if (m > n)
+        throw std::invalid_argument("The argument 'm' is more than the argument 'n'");
+    if (n > element_limit)
+        throw std::invalid_argument("The argument 'n' is more than 2^32");
+    if (m == 0)
+    {
+        if (n != 0)
+            throw std::invalid_argument("There is no surjection onto the empty set");
+        return;
+    }
+
+    // Many more elements than values: a uniform random function is surjective with probability above 0.87
+    if (static_cast<double>(n) >= static_cast<double>(m) * (std::log(static_cast<double>(m)) + 2))
+    {
+        if (this->__scratch.size() < m / 64 + 1)
+        {
+            IMD_PROBE_ALLOCATION(surjection, (m / 64 + 1) * sizeof(std::uint64_t));
+            this->__scratch.resize(m / 64 + 1, 0);
+        }
+        std::uint64_t *hit = this->__scratch.data();
+
+        for (;;)
+        {
+            size_t distinct(0);
+            for (size_t i(0); i < n; ++i)
+            {
+                const std::uint64_t v = this->bounded(m);
+                out[i] = static_cast<element_type>(v);
+                if (!(hit[v / 64] & (std::uint64_t(1) << (v % 64))))
+                {
+                    hit[v / 64] |= std::uint64_t(1) << (v % 64);
+                    ++distinct;
+                }
+            }
+            std::fill(hit, hit + m / 64 + 1, 0);
+            if (distinct == m)
+                return;
+            IMD_PROBE_STEPS(surjection, 1); // a rejected function
+        }
+    }
+
+    // A uniform set partition into m blocks, built from the last element: it is a singleton block
+    // with probability S(i - 1, j - 1) / S(i, j), otherwise it joins one of j blocks uniformly
+    this->prepare_Stirling(n, m);
+    const double *S = this->__Stirling.data();
+    const size_t width = m + 1;
+
+    size_t j(m);
+    for (size_t i(n); i > 0; --i)
+    {
+        const double singleton = (j == i) ? 1.0 : std::exp(S[(i - 1) * width + j - 1] - S[i * width + j]);
+        if (uniform_unit(this->__generator) < singleton)
+            out[i - 1] = static_cast<element_type>(--j);
+        else
+            out[i - 1] = static_cast<element_type>(this->bounded(j));
+    }
+
+    // A uniform labelling of the blocks
+    this->__labels.resize(m);
+    this->permutation(m, this->__labels.data());
+    for (size_t i(0); i < n; ++i)
+        out[i] = this->__labels[out[i]];
+}
+
+void IMD::combinatorial_sampler::k_subsets(size_t n, size_t k, size_t amount, element_type *out)
+{
+    IMD_PROBE_CALL(k_subset);
+    for (size_t i(0); i < amount; ++i, out += k)
+        this->k_subset(n, k, out);
+}
+void IMD::combinatorial_sampler::permutations(size_t n, size_t amount, element_type *out)
+{
+    IMD_PROBE_CALL(permutation);
+    for (size_t i(0); i < amount; ++i, out += n)
+        this->permutation(n, out);
+}
+void IMD::combinatorial_sampler::Dyck_paths(size_t n, size_t amount, unsigned char *out)
+{
+    IMD_PROBE_CALL(Dyck_path);
+    for (size_t i(0); i < amount; ++i, out += 2 * n)
+        this->Dyck_path(n, out);
+}
+void IMD::combinatorial_sampler::surjections(size_t n, size_t m, size_t amount, element_type *out)
+{
+    IMD_PROBE_CALL(surjection);
+    for (size_t i(0); i < amount; ++i, out += n)
+        this->surjection(n, m, out);
+}
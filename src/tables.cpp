@@ -0,0 +1,454 @@
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include "../include/tables.h"
+#include "../include/instrumentation.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+namespace
+{
+    using element_type = IMD::precomputed_table::element_type;
+    using table_kind = IMD::precomputed_table::kind;
+
+    constexpr char table_magic[8] = {'I', 'M', 'D', 'T', 'A', 'B', 'L', 'E'};
+
+    struct file_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t kind;
+        std::uint64_t modulus;
+        std::uint64_t size;
+        std::uint64_t length;
+        std::uint64_t checksum;
+    };
+
+    // The payload elements a file can hold at most, the byte length of the file has to fit into 64 bits
+    constexpr std::uint64_t max_payload_length = (~std::uint64_t(0) - sizeof(file_header)) / sizeof(element_type);
+
+    // The largest size of a table whose payload fits into a file, below it payload_length doesn't overflow
+    std::uint64_t max_size(table_kind k)
+    {
+        switch (k)
+        {
+        case table_kind::Pascal_triangle:
+            return 0x7FFFFFFFULL; // 2^31 * (2^31 - 1) / 2 < 2^61
+        case table_kind::factorials:
+            return max_payload_length / 2;
+        case table_kind::Catalan_numbers:
+        case table_kind::Fibonacci_numbers:
+            return max_payload_length;
+        }
+        throw std::invalid_argument("Unknown table kind");
+    }
+
+    std::uint64_t payload_length(table_kind k, std::uint64_t size)
+    {
+        if (size > max_size(k))
+            throw std::invalid_argument("The argument 'size' is too large");
+
+        switch (k)
+        {
+        case table_kind::Pascal_triangle:
+            return size * (size + 1) / 2;
+        case table_kind::factorials:
+            return 2 * size;
+        case table_kind::Catalan_numbers:
+        case table_kind::Fibonacci_numbers:
+            return size;
+        }
+        throw std::invalid_argument("Unknown table kind");
+    }
+
+    // FNV-1a over the 64-bit words
+    std::uint64_t checksum(const element_type *data, std::uint64_t length) noexcept
+    {
+        std::uint64_t res(14695981039346656037ULL);
+        for (std::uint64_t i(0); i < length; ++i)
+        {
+            res ^= data[i];
+            res *= 1099511628211ULL;
+        }
+        return res;
+    }
+
+    bool is_prime(std::uint64_t num) noexcept
+    {
+        if (num < 2)
+            return false;
+        for (std::uint64_t d(2); d * d <= num; ++d)
+            if (num % d == 0)
+                return false;
+        return true;
+    }
+
+    element_type add_modulo(element_type a, element_type b, element_type modulus) noexcept
+    {
+        if (modulus == 0)
+            return a + b;
+        return (a >= modulus - b) ? a - (modulus - b) : a + b;
+    }
+
+    // Both operands have to be below 2^32
+    element_type power_modulo(element_type base, element_type exponent, element_type modulus) noexcept
+    {
+        element_type res(1 % modulus);
+        for (base %= modulus; exponent > 0; exponent >>= 1, base = base * base % modulus)
+            if (exponent & 1)
+                res = res * base % modulus;
+        return res;
+    }
+
+    void check_exact_limit(element_type modulus, std::uint64_t size, std::uint64_t limit)
+    {
+        if (modulus == 0 && size > limit)
+            throw std::invalid_argument("The exact values of the table don't fit into 64 bits");
+        if (modulus > 0xFFFFFFFFULL)
+            throw std::invalid_argument("The argument 'modulus' is more than 2^32");
+    }
+
+    void fill_Pascal_triangle(element_type *out, std::uint64_t size, element_type modulus)
+    {
+        if (modulus == 0 && size > 68)
+            throw std::invalid_argument("The exact values of the table don't fit into 64 bits");
+
+        const element_type one = (modulus == 1) ? 0 : 1;
+        element_type *prev = nullptr;
+        for (std::uint64_t i(0); i < size; ++i)
+        {
+            element_type *row = out + i * (i + 1) / 2;
+            row[0] = row[i] = one;
+            for (std::uint64_t j(1); j < i; ++j)
+                row[j] = add_modulo(prev[j - 1], prev[j], modulus);
+            prev = row;
+        }
+    }
+
+    void fill_factorials(element_type *out, std::uint64_t size, element_type modulus)
+    {
+        if (!is_prime(modulus) || modulus > 0xFFFFFFFFULL)
+            throw std::invalid_argument("The factorial tables require a prime modulus below 2^32");
+        if (size > modulus)
+            throw std::invalid_argument("The argument 'size' is more than the modulus: the factorials are zero");
+        if (size == 0)
+            return;
+
+        element_type *inverse = out + size;
+        out[0] = 1;
+        for (std::uint64_t i(1); i < size; ++i)
+            out[i] = out[i - 1] * i % modulus;
+
+        inverse[size - 1] = power_modulo(out[size - 1], modulus - 2, modulus);
+        for (std::uint64_t i(size - 1); i > 0; --i)
+            inverse[i - 1] = inverse[i] * i % modulus;
+    }
+
+    void fill_Catalan_numbers(element_type *out, std::uint64_t size, element_type modulus)
+    {
+        check_exact_limit(modulus, size, 37);
+        if (size == 0)
+            return;
+
+        // C_n = (2n)! / (n! (n + 1)!) when all the factorials are invertible
+        if (is_prime(modulus) && 2 * size <= modulus)
+        {
+            std::vector<element_type> f(4 * size); // factorials and inverse factorials up to 2 * size
+            fill_factorials(f.data(), 2 * size, modulus);
+            const element_type *inverse = f.data() + 2 * size;
+            for (std::uint64_t n(0); n < size; ++n)
+                out[n] = f[2 * n] * inverse[n] % modulus * inverse[n + 1] % modulus;
+            return;
+        }
+
+        // C_{n + 1} = sum C_i * C_{n - i}
+        out[0] = (modulus == 1) ? 0 : 1;
+        for (std::uint64_t n(1); n < size; ++n)
+        {
+            element_type sum(0);
+            for (std::uint64_t i(0); i < n; ++i)
+            {
+                const element_type term = (modulus == 0) ? out[i] * out[n - 1 - i] : out[i] * out[n - 1 - i] % modulus;
+                sum = add_modulo(sum, term, modulus);
+            }
+            out[n] = sum;
+        }
+    }
+
+    void fill_Fibonacci_numbers(element_type *out, std::uint64_t size, element_type modulus)
+    {
+        if (modulus == 0 && size > 94)
+            throw std::invalid_argument("The exact values of the table don't fit into 64 bits");
+
+        for (std::uint64_t i(0); i < size; ++i)
+            out[i] = (i < 2) ? (modulus == 0 ? i : i % modulus) : add_modulo(out[i - 1], out[i - 2], modulus);
+    }
+
+    void fill(table_kind k, element_type *out, std::uint64_t size, element_type modulus)
+    {
+        switch (k)
+        {
+        case table_kind::Pascal_triangle:
+            fill_Pascal_triangle(out, size, modulus);
+            break;
+        case table_kind::factorials:
+            fill_factorials(out, size, modulus);
+            break;
+        case table_kind::Catalan_numbers:
+            fill_Catalan_numbers(out, size, modulus);
+            break;
+        case table_kind::Fibonacci_numbers:
+            fill_Fibonacci_numbers(out, size, modulus);
+            break;
+        }
+    }
+}
+
+IMD::precomputed_table::precomputed_table(kind k, element_type modulus, std::uint64_t size)
+    : __kind(k), __modulus(modulus), __size(size), __data(nullptr), __mapping(nullptr), __mapping_length(0) {}
+
+IMD::precomputed_table::precomputed_table(precomputed_table &&other) noexcept
+    : __kind(other.__kind), __modulus(other.__modulus), __size(other.__size),
+      __data(other.__data), __storage(std::move(other.__storage)),
+      __mapping(other.__mapping), __mapping_length(other.__mapping_length)
+{
+    if (this->__mapping == nullptr)
+        this->__data = this->__storage.data();
+
+    other.__data = nullptr;
+    other.__mapping = nullptr;
+    other.__mapping_length = 0;
+    other.__size = 0;
+}
+
+IMD::precomputed_table::~precomputed_table()
+{
+    this->release();
+}
+
+IMD::precomputed_table &IMD::precomputed_table::operator=(precomputed_table &&other) noexcept
+{
+    if (this != &other)
+    {
+        this->release();
+
+        this->__kind = other.__kind;
+        this->__modulus = other.__modulus;
+        this->__size = other.__size;
+        this->__storage = std::move(other.__storage);
+        this->__mapping = other.__mapping;
+        this->__mapping_length = other.__mapping_length;
+        this->__data = (this->__mapping == nullptr) ? this->__storage.data() : other.__data;
+
+        other.__data = nullptr;
+        other.__mapping = nullptr;
+        other.__mapping_length = 0;
+        other.__size = 0;
+    }
+    return *this;
+}
+
+void IMD::precomputed_table::release() noexcept
+{
+#ifndef _WIN32
+    if (this->__mapping != nullptr)
+        munmap(this->__mapping, this->__mapping_length);
+#endif
+    this->__mapping = nullptr;
+    this->__mapping_length = 0;
+    this->__data = nullptr;
+    this->__storage.clear();
+}
+
+IMD::precomputed_table IMD::precomputed_table::open(const std::string &path, kind k, element_type modulus, bool verify_checksum)
+{
+    IMD_PROBE_CALL(precomputed_table);
+
+    file_header header;
+
+#ifndef _WIN32
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Can't open the table file '" + path + "'");
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::uint64_t>(info.st_size) < sizeof(file_header) ||
+        pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+    {
+        ::close(fd);
+        throw std::runtime_error("The table file '" + path + "' is damaged");
+    }
+    const std::uint64_t file_size = static_cast<std::uint64_t>(info.st_size);
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+        throw std::runtime_error("Can't open the table file '" + path + "'");
+    const std::uint64_t file_size = static_cast<std::uint64_t>(in.tellg());
+    in.seekg(0);
+    if (file_size < sizeof(file_header) || !in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        throw std::runtime_error("The table file '" + path + "' is damaged");
+#endif
+
+    // The sizes are checked against the file length before they are multiplied, a damaged header can't overflow them
+    const std::uint64_t payload_bytes = file_size - sizeof(file_header);
+    const bool valid = std::memcmp(header.magic, table_magic, sizeof(table_magic)) == 0 &&
+                       header.version == format_version &&
+                       header.kind == static_cast<std::uint32_t>(k) &&
+                       header.modulus == modulus &&
+                       payload_bytes % sizeof(element_type) == 0 &&
+                       header.length == payload_bytes / sizeof(element_type) &&
+                       header.size <= max_size(k) &&
+                       header.length == payload_length(k, header.size);
+    if (!valid)
+    {
+#ifndef _WIN32
+        ::close(fd);
+#endif
+        throw std::runtime_error("The table file '" + path + "' doesn't match the requested table");
+    }
+
+    precomputed_table res(k, modulus, header.size);
+
+#ifndef _WIN32
+    void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Can't map the table file '" + path + "'");
+
+    res.__mapping = mapping;
+    res.__mapping_length = file_size;
+    res.__data = reinterpret_cast<const element_type *>(static_cast<const char *>(mapping) + sizeof(file_header));
+#else
+    res.__storage.resize(header.length);
+    if (!in.read(reinterpret_cast<char *>(res.__storage.data()), header.length * sizeof(element_type)))
+        throw std::runtime_error("The table file '" + path + "' is damaged");
+    res.__data = res.__storage.data();
+#endif
+
+    if (verify_checksum && checksum(res.__data, header.length) != header.checksum)
+        throw std::runtime_error("The checksum of the table file '" + path + "' doesn't match");
+    return res;
+}
+
+IMD::precomputed_table IMD::precomputed_table::compute(kind k, std::uint64_t size, element_type modulus)
+{
+    IMD_PROBE_CALL(precomputed_table);
+
+    precomputed_table res(k, modulus, size);
+    res.__storage.resize(payload_length(k, size));
+    IMD_PROBE_ALLOCATION(precomputed_table, res.__storage.size() * sizeof(element_type));
+    fill(k, res.__storage.data(), size, modulus);
+    res.__data = res.__storage.data();
+    return res;
+}
+
+IMD::precomputed_table IMD::precomputed_table::open_or_compute(const std::string &path, kind k, std::uint64_t size, element_type modulus)
+{
+    IMD_PROBE_CALL(precomputed_table);
+
+    try
+    {
+        precomputed_table res = open(path, k, modulus);
+        if (res.size() >= size)
+            return res;
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+    return compute(k, size, modulus);
+}
+
+void IMD::precomputed_table::generate(const std::string &path, kind k, std::uint64_t size, element_type modulus)
+{
+    IMD_PROBE_CALL(precomputed_table);
+
+    const precomputed_table table = compute(k, size, modulus);
+
+    file_header header;
+    std::memcpy(header.magic, table_magic, sizeof(table_magic));
+    header.version = format_version;
+    header.kind = static_cast<std::uint32_t>(k);
+    header.modulus = modulus;
+    header.size = size;
+    header.length = table.length();
+    header.checksum = checksum(table.data(), table.length());
+
+    // Writing into a temporary file and renaming it keeps the readers from seeing a half written table
+    const std::string tmp_path = path + ".tmp";
+    {
+        IMD_PROBE_IO(precomputed_table);
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(table.data()), header.length * sizeof(element_type));
+        if (!out)
+            throw std::runtime_error("Can't write the table file '" + tmp_path + "'");
+    }
+
+    // The rename replaces an existing table in one step, so the path never misses a complete table
+#ifndef _WIN32
+    const bool renamed = std::rename(tmp_path.c_str(), path.c_str()) == 0;
+#else
+    const bool renamed = MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#endif
+    if (!renamed)
+        throw std::runtime_error("Can't rename the table file '" + tmp_path + "'");
+}
+
+IMD::precomputed_table::kind IMD::precomputed_table::table_kind() const noexcept
+{
+    return this->__kind;
+}
+IMD::precomputed_table::element_type IMD::precomputed_table::modulus() const noexcept
+{
+    return this->__modulus;
+}
+std::uint64_t IMD::precomputed_table::size() const noexcept
+{
+    return this->__size;
+}
+bool IMD::precomputed_table::mapped() const noexcept
+{
+    return this->__mapping != nullptr;
+}
+bool IMD::precomputed_table::verify() const noexcept
+{
+    if (!this->mapped())
+        return true;
+
+    const file_header *header = static_cast<const file_header *>(this->__mapping);
+    return checksum(this->__data, header->length) == header->checksum;
+}
+
+const IMD::precomputed_table::element_type *IMD::precomputed_table::data() const noexcept
+{
+    return this->__data;
+}
+std::uint64_t IMD::precomputed_table::length() const noexcept
+{
+    return payload_length(this->__kind, this->__size);
+}
+
+IMD::precomputed_table::element_type IMD::precomputed_table::binomial(std::uint64_t k, std::uint64_t n) const noexcept
+{
+    return this->__data[n * (n + 1) / 2 + k];
+}
+IMD::precomputed_table::element_type IMD::precomputed_table::factorial(std::uint64_t n) const noexcept
+{
+    return this->__data[n];
+}
+IMD::precomputed_table::element_type IMD::precomputed_table::inverse_factorial(std::uint64_t n) const noexcept
+{
+    return this->__data[this->__size + n];
+}
+IMD::precomputed_table::element_type IMD::precomputed_table::operator[](std::uint64_t index) const noexcept
+{
+    return this->__data[index];
+}
@@ -0,0 +1,49 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "benchmark.h"
+
+// The replaced global operator new and delete of the benchmarks: every allocation goes through std::malloc and every
+// deallocation through std::free, so the pairs match. Link this file exactly once into every benchmark
+namespace IMD::benchmark
+{
+    std::atomic<size_t> allocations(0);
+    std::atomic<size_t> allocated_bytes(0);
+}
+
+namespace
+{
+    void *counted_malloc(size_t size)
+    {
+        IMD::benchmark::allocations.fetch_add(1, std::memory_order_relaxed);
+        IMD::benchmark::allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        if (void *p = std::malloc(size != 0 ? size : 1))
+            return p;
+        throw std::bad_alloc();
+    }
+}
+
+void *operator new(size_t size)
+{
+    return counted_malloc(size);
+}
+void *operator new[](size_t size)
+{
+    return counted_malloc(size);
+}
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,71 @@
+#ifndef __IMD_BENCHMARK_
+#define __IMD_BENCHMARK_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+// Shared helpers of the benchmarks in tools/. Every benchmark is built together with tools/allocation_counter.cpp and the
+// library sources, e.g. g++ -std=c++20 -O2 tools/benchmark_Pascal_rows.cpp tools/allocation_counter.cpp src/combinatorics.cpp
+// src/instrumentation.cpp. allocation_counter.cpp replaces the global operator new and delete to count the heap allocations
+namespace IMD::benchmark
+{
+    extern std::atomic<size_t> allocations;
+    extern std::atomic<size_t> allocated_bytes;
+
+    // Keeps 'value' alive, so the optimizer can't drop the computation producing it
+    template <typename T>
+    inline void keep(const T &value)
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        static const volatile void *sink;
+        sink = &value;
+#endif
+    }
+
+    struct measurement
+    {
+        double nanoseconds;        // per call
+        double allocations;        // per call
+        double allocated_bytes;    // per call
+    };
+
+    // Runs 'f' once to warm up the caches and the scratch buffers, then 'repetitions' times
+    template <typename F>
+    measurement measure(size_t repetitions, F &&f)
+    {
+        f();
+
+        const size_t allocations_before = allocations.load(), bytes_before = allocated_bytes.load();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i(0); i < repetitions; ++i)
+            f();
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+        return {elapsed.count() / repetitions,
+                static_cast<double>(allocations.load() - allocations_before) / repetitions,
+                static_cast<double>(allocated_bytes.load() - bytes_before) / repetitions};
+    }
+
+    inline void print_header()
+    {
+        std::printf("%-52s %14s %14s %14s\n", "", "ns/call", "allocs/call", "bytes/call");
+    }
+
+    inline void print(const std::string &name, const measurement &m)
+    {
+        std::printf("%-52s %14.1f %14.2f %14.1f\n", name.c_str(), m.nanoseconds, m.allocations, m.allocated_bytes);
+    }
+
+    // Repetitions from the first command line argument
+    inline size_t repetitions(int argc, char **argv, size_t fallback)
+    {
+        return (argc > 1) ? std::stoull(argv[1]) : fallback;
+    }
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <memory_resource>
+#include <stdexcept>
+#include <utility>
+#include "../include/combinatorics.h"
+#include "benchmark.h"
+
+// Usage: benchmark_Pascal_rows [repetitions]
+// Heap allocations and time per call of the legacy new[] Pascal APIs against the caller buffer, std::span and
+// std::pmr overloads, and of the half-row Pascal_binomial_coefficient against reading one element of a full new[] row
+namespace
+{
+    constexpr size_t row_index = 60;
+    constexpr size_t rows_amount = 68;
+
+    // What Pascal_binomial_coefficient did before it kept the half row on the stack
+    unsigned long long full_row_binomial_coefficient(size_t k, size_t n)
+    {
+        unsigned long long *row = IMD::Pascal_triangle_row(n);
+        const unsigned long long res = row[k];
+        delete[] row;
+        return res;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace IMD::benchmark;
+
+    try
+    {
+        const size_t amount = repetitions(argc, argv, 100000);
+        const std::string row_name = "row " + std::to_string(row_index), triangle_name = "triangle " + std::to_string(rows_amount);
+        print_header();
+
+        // Rows
+        const auto legacy_row = []
+        {
+            unsigned long long *row = IMD::Pascal_triangle_row(row_index);
+            keep(row[row_index / 2]);
+            delete[] row;
+        };
+        print(row_name + ", new[] (legacy)", measure(amount, legacy_row));
+
+        unsigned long long buffer[row_index + 1];
+        const auto buffer_row = [&]
+        {
+            IMD::Pascal_triangle_row(row_index, buffer, row_index + 1);
+            keep(buffer[row_index / 2]);
+        };
+        print(row_name + ", caller buffer", measure(amount, buffer_row));
+#ifdef __cpp_lib_span
+        const auto span_row = [&]
+        {
+            IMD::Pascal_triangle_row(row_index, std::span<unsigned long long>(buffer));
+            keep(buffer[row_index / 2]);
+        };
+        print(row_name + ", std::span", measure(amount, span_row));
+#endif
+
+        // The monotonic resource hands out the stack storage and takes it back as a whole on release()
+        std::byte storage[64 * 1024];
+        std::pmr::monotonic_buffer_resource monotonic(storage, sizeof(storage), std::pmr::null_memory_resource());
+        const auto monotonic_row = [&]
+        {
+            keep(IMD::Pascal_triangle_row(row_index, &monotonic)[row_index / 2]);
+            monotonic.release();
+        };
+        print(row_name + ", pmr monotonic", measure(amount, monotonic_row));
+
+        // Triangles
+        const size_t triangles_amount = amount / 10 + 1;
+        const auto legacy_triangle = []
+        {
+            unsigned long long **triangle = IMD::Pascal_triangle(rows_amount);
+            keep(triangle[rows_amount - 1][rows_amount / 2]);
+            for (size_t i(0); i < rows_amount; ++i)
+                delete[] triangle[i];
+            delete[] triangle;
+        };
+        print(triangle_name + ", new[] (legacy)", measure(triangles_amount, legacy_triangle));
+
+        const auto monotonic_triangle = [&]
+        {
+            keep(IMD::Pascal_triangle(rows_amount, &monotonic)[rows_amount - 1][rows_amount / 2]);
+            monotonic.release();
+        };
+        print(triangle_name + ", pmr monotonic", measure(triangles_amount, monotonic_triangle));
+
+        std::pmr::unsynchronized_pool_resource pool;
+        const auto pool_triangle = [&]
+        {
+            keep(IMD::Pascal_triangle(rows_amount, &pool)[rows_amount - 1][rows_amount / 2]);
+        };
+        print(triangle_name + ", pmr pool", measure(triangles_amount, pool_triangle));
+
+        // Binomial coefficients, C(1000, 500) overflows but shows the scratch buffer of the large k
+        for (const auto &[k, n] : {std::pair<size_t, size_t>{5, 60}, {30, 60}, {500, 1000}})
+        {
+            const size_t queries = (n > 100) ? amount / 100 + 1 : amount;
+            const std::string name = "C(" + std::to_string(n) + ", " + std::to_string(k) + ")";
+            print(name + ", full new[] row (before)", measure(queries, [&]
+                                                            { keep(full_row_binomial_coefficient(k, n)); }));
+            print(name + ", half row", measure(queries, [&]
+                                             { keep(IMD::Pascal_binomial_coefficient(k, n)); }));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
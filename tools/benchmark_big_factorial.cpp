@@ -0,0 +1,66 @@
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "../include/combinatorics.h"
+#include "benchmark.h"
+
+// Usage: benchmark_big_factorial [repetitions]
+// big_factorial (prime swing over a segmented sieve, balanced product trees) on one and on every hardware thread
+// against multiplying 1 * 2 * ... * n into a big_unsigned one limb at a time, and big_multinomial_coefficient
+namespace
+{
+    IMD::big_unsigned naive_factorial(size_t n)
+    {
+        IMD::big_unsigned res(1);
+        for (size_t i(2); i <= n; ++i)
+            res *= static_cast<IMD::big_unsigned::limb_type>(i);
+        return res;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace IMD::benchmark;
+
+    try
+    {
+        const size_t scale = repetitions(argc, argv, 1);
+        const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        print_header();
+
+        for (const size_t n : {1000, 10000, 100000, 1000000})
+        {
+            // The naive product is quadratic, 10^6! would take minutes
+            const size_t calls = scale * std::max<size_t>(1, 100000 / n);
+            const std::string name = std::to_string(n) + "!";
+
+            IMD::big_unsigned result;
+            print(name + ", big_factorial", measure(calls, [&]
+                                                    { result = IMD::big_factorial(n); }));
+            if (threads > 1)
+                print(name + ", big_factorial, " + std::to_string(threads) + " threads", measure(calls, [&]
+                                                                                               { result = IMD::big_factorial(n, threads); }));
+            if (n <= 100000)
+            {
+                IMD::big_unsigned naive;
+                print(name + ", naive multiplication", measure(calls, [&]
+                                                               { naive = naive_factorial(n); }));
+                if (naive != result)
+                    throw std::logic_error("big_factorial(" + std::to_string(n) + ") differs from the naive product");
+            }
+
+            // (n; n/4, n/4, n/4, n/4) has the size of n! divided by about four factorials of n/4
+            const std::vector<size_t> parts(4, n / 4);
+            print("(" + std::to_string(n) + "; 4 x " + std::to_string(n / 4) + "), big_multinomial_coefficient",
+                  measure(calls, [&]
+                          { keep(IMD::big_multinomial_coefficient(parts)); }));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
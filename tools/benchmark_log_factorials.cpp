@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "../include/combinatorics.h"
+#include "benchmark.h"
+
+// Usage: benchmark_log_factorials [repetitions]
+// Throughput of the log-space factorials and binomials, single and batched, against a std::lgamma call per query,
+// with the largest relative difference from std::lgamma. The batches pick their AVX2 kernels at run time, no flags needed
+namespace
+{
+    constexpr size_t amount = 4096;
+
+    double lgamma_binomial(unsigned long long k, unsigned long long n)
+    {
+        return std::lgamma(n + 1.0) - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0);
+    }
+
+    double relative_difference(double value, double expected)
+    {
+        return (expected == 0) ? std::fabs(value) : std::fabs(value - expected) / std::fabs(expected);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace IMD::benchmark;
+
+    try
+    {
+        const size_t batches = repetitions(argc, argv, 200);
+
+        std::mt19937_64 generator(2024);
+        for (const unsigned long long limit : {200ULL, 1000000ULL, 1ULL << 40})
+        {
+            std::uniform_int_distribution<unsigned long long> distribution(0, limit);
+            std::vector<unsigned long long> n(amount), k(amount);
+            for (size_t i(0); i < amount; ++i)
+            {
+                n[i] = distribution(generator);
+                k[i] = std::uniform_int_distribution<unsigned long long>(0, n[i])(generator);
+            }
+            std::vector<double> out(amount), expected(amount);
+
+            std::cout << "n in [0, " << limit << "], " << amount << " queries per call" << std::endl;
+            print_header();
+
+            const auto lgamma_factorials = [&]
+            {
+                for (size_t i(0); i < amount; ++i)
+                    expected[i] = std::lgamma(n[i] + 1.0);
+                keep(expected[amount - 1]);
+            };
+            print("factorials, std::lgamma", measure(batches, lgamma_factorials));
+
+            const auto single_factorials = [&]
+            {
+                for (size_t i(0); i < amount; ++i)
+                    out[i] = IMD::log_factorial(n[i]);
+                keep(out[amount - 1]);
+            };
+            print("factorials, log_factorial", measure(batches, single_factorials));
+
+            const auto batch_factorials = [&]
+            {
+                IMD::log_factorials(n.data(), amount, out.data());
+                keep(out[amount - 1]);
+            };
+            print("factorials, log_factorials", measure(batches, batch_factorials));
+
+            double difference(0);
+            for (size_t i(0); i < amount; ++i)
+                difference = std::max(difference, relative_difference(out[i], expected[i]));
+            std::cout << "    max relative difference " << difference << std::endl;
+
+            const auto lgamma_binomials = [&]
+            {
+                for (size_t i(0); i < amount; ++i)
+                    expected[i] = lgamma_binomial(k[i], n[i]);
+                keep(expected[amount - 1]);
+            };
+            print("binomials, std::lgamma", measure(batches, lgamma_binomials));
+
+            const auto single_binomials = [&]
+            {
+                for (size_t i(0); i < amount; ++i)
+                    out[i] = IMD::log_binomial_coefficient(k[i], n[i]);
+                keep(out[amount - 1]);
+            };
+            print("binomials, log_binomial_coefficient", measure(batches, single_binomials));
+
+            const auto batch_binomials = [&]
+            {
+                IMD::log_binomial_coefficients(k.data(), n.data(), amount, out.data());
+                keep(out[amount - 1]);
+            };
+            print("binomials, log_binomial_coefficients", measure(batches, batch_binomials));
+
+            // std::lgamma cancels catastrophically for k close to 0 or n, so this is the error of the reference as well
+            difference = 0;
+            for (size_t i(0); i < amount; ++i)
+                difference = std::max(difference, relative_difference(out[i], expected[i]));
+            std::cout << "    max relative difference " << difference << std::endl
+                      << std::endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
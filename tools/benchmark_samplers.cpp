@@ -0,0 +1,98 @@
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "../include/sampling.h"
+#include "benchmark.h"
+
+// Usage: benchmark_samplers [repetitions]
+// Samples per second of the bulk combinatorial_sampler functions, each call writes 'amount' samples into one buffer,
+// and of parallel_samples on every hardware thread. A sampler reuses its scratch buffers, so the calls don't allocate
+namespace
+{
+    constexpr size_t amount = 1000;
+
+    void print_rate(const std::string &name, const IMD::benchmark::measurement &m)
+    {
+        IMD::benchmark::print(name, m);
+        std::cout << "    " << amount / m.nanoseconds * 1e9 << " samples/s" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace IMD::benchmark;
+    using element_type = IMD::combinatorial_sampler::element_type;
+
+    try
+    {
+        const size_t calls = repetitions(argc, argv, 200);
+        IMD::combinatorial_sampler sampler(2024);
+        std::vector<element_type> elements;
+        std::vector<unsigned char> steps;
+
+        std::cout << amount << " samples per call" << std::endl;
+        print_header();
+
+        for (const auto &[n, k] : {std::pair<size_t, size_t>{1000, 10}, {1000000, 100}, {100, 50}})
+        {
+            elements.resize(amount * k);
+            const auto subsets = [&]
+            {
+                sampler.k_subsets(n, k, amount, elements.data());
+                keep(elements.back());
+            };
+            print_rate(std::to_string(k) + "-subsets of " + std::to_string(n), measure(calls, subsets));
+        }
+
+        for (const size_t n : {10, 100, 1000})
+        {
+            elements.resize(amount * n);
+            const auto permutations = [&]
+            {
+                sampler.permutations(n, amount, elements.data());
+                keep(elements.back());
+            };
+            print_rate("permutations of " + std::to_string(n), measure(calls, permutations));
+        }
+
+        for (const size_t n : {10, 100, 1000})
+        {
+            steps.resize(amount * 2 * n);
+            const auto paths = [&]
+            {
+                sampler.Dyck_paths(n, amount, steps.data());
+                keep(steps.back());
+            };
+            print_rate("Dyck paths of " + std::to_string(2 * n) + " steps", measure(calls, paths));
+        }
+
+        for (const auto &[n, m] : {std::pair<size_t, size_t>{10, 5}, {100, 30}, {1000, 100}})
+        {
+            elements.resize(amount * n);
+            const auto surjections = [&]
+            {
+                sampler.surjections(n, m, amount, elements.data());
+                keep(elements.back());
+            };
+            print_rate("surjections " + std::to_string(n) + " -> " + std::to_string(m), measure(calls, surjections));
+        }
+
+        // Every thread runs its own sampler on an independent stream, the thread start is part of the measurement
+        const size_t threads = std::max(1u, std::thread::hardware_concurrency()), n = 100;
+        elements.resize(amount * n);
+        const auto parallel_permutations = [&]
+        {
+            IMD::parallel_samples(2024, threads, amount, n, elements.data(), [n](IMD::combinatorial_sampler &s, size_t count, element_type *out)
+                                  { s.permutations(n, count, out); });
+            keep(elements.back());
+        };
+        print_rate("permutations of 100, " + std::to_string(threads) + " threads", measure(calls, parallel_permutations));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "../include/combinatorics.h"
+#include "benchmark.h"
+
+// Usage: benchmark_wide_integers [repetitions]
+// The 128-bit binomials, factorials and surjections against the 64-bit functions (where the result fits) and the big_unsigned
+// ones, and the exact_* functions picking the width. Every path is checked to give the same decimal digits
+namespace
+{
+    const char *width_name(IMD::exact_unsigned::width_type width)
+    {
+        switch (width)
+        {
+        case IMD::exact_unsigned::width_type::bits_64:
+            return "64 bits";
+        case IMD::exact_unsigned::width_type::bits_128:
+            return "128 bits";
+        default:
+            return "arbitrary";
+        }
+    }
+
+    void check(const std::string &name, const std::string &value, const std::string &expected)
+    {
+        if (value != expected)
+            throw std::logic_error(name + " gives " + value + " instead of " + expected);
+    }
+}
+
+int main(int argc, char **argv)
+{
+#ifdef __SIZEOF_INT128__
+    using namespace IMD::benchmark;
+
+    try
+    {
+        const size_t calls = repetitions(argc, argv, 100000);
+        print_header();
+
+        for (const auto &[k, n] : {std::pair<size_t, size_t>{30, 60}, {33, 67}, {60, 120}, {65, 130}})
+        {
+            const IMD::exact_unsigned exact = IMD::exact_binomial_coefficient(k, n);
+            const std::string name = "C(" + std::to_string(n) + ", " + std::to_string(k) + ")", digits = exact.to_string();
+            std::cout << name << " = " << digits << " (" << width_name(exact.width) << ")" << std::endl;
+
+            if (exact.width == IMD::exact_unsigned::width_type::bits_64)
+            {
+                check(name, std::to_string(IMD::iterative_binomial_coefficient(k, n)), digits);
+                print(name + ", iterative_binomial_coefficient", measure(calls, [&]
+                                                                          { keep(IMD::iterative_binomial_coefficient(k, n)); }));
+            }
+            check(name, IMD::to_string(IMD::binomial_coefficient_128(k, n)), digits);
+            print(name + ", binomial_coefficient_128", measure(calls, [&]
+                                                                { keep(IMD::binomial_coefficient_128(k, n)); }));
+            const std::vector<size_t> parts{k, n - k};
+            check(name, IMD::big_multinomial_coefficient(parts).to_string(), digits);
+            print(name + ", big_multinomial_coefficient", measure(calls, [&]
+                                                                   { keep(IMD::big_multinomial_coefficient(parts)); }));
+            print(name + ", exact_binomial_coefficient", measure(calls, [&]
+                                                                  { keep(IMD::exact_binomial_coefficient(k, n)); }));
+        }
+
+        for (const size_t n : {20, 34})
+        {
+            const IMD::exact_unsigned exact = IMD::exact_factorial(n);
+            const std::string name = std::to_string(n) + "!", digits = exact.to_string();
+            std::cout << name << " = " << digits << " (" << width_name(exact.width) << ")" << std::endl;
+
+            if (exact.width == IMD::exact_unsigned::width_type::bits_64)
+            {
+                check(name, std::to_string(IMD::iterative_factorial(n)), digits);
+                print(name + ", iterative_factorial", measure(calls, [&]
+                                                               { keep(IMD::iterative_factorial(n)); }));
+            }
+            check(name, IMD::to_string(IMD::factorial_128(n)), digits);
+            print(name + ", factorial_128", measure(calls, [&]
+                                                     { keep(IMD::factorial_128(n)); }));
+            check(name, IMD::big_factorial(n).to_string(), digits);
+            print(name + ", big_factorial", measure(calls, [&]
+                                                     { keep(IMD::big_factorial(n)); }));
+            print(name + ", exact_factorial", measure(calls, [&]
+                                                       { keep(IMD::exact_factorial(n)); }));
+        }
+
+        // Beyond 128 bits exact_surjective_mappings runs the same recurrence on big_unsigned cells
+        for (const auto &[n, m] : {std::pair<size_t, size_t>{15, 5}, {20, 10}, {30, 12}, {60, 30}})
+        {
+            const IMD::exact_unsigned exact = IMD::exact_surjective_mappings(n, m);
+            const std::string name = "surjections " + std::to_string(n) + " -> " + std::to_string(m), digits = exact.to_string();
+            std::cout << name << " = " << digits << " (" << width_name(exact.width) << ")" << std::endl;
+
+            if (exact.width == IMD::exact_unsigned::width_type::bits_64)
+            {
+                check(name, std::to_string(IMD::surjective_mappings_inclusion_exclusion(n, m)), digits);
+                print(name + ", inclusion-exclusion, 64 bits", measure(calls, [&]
+                                                                                   { keep(IMD::surjective_mappings_inclusion_exclusion(n, m)); }));
+            }
+            if (exact.width != IMD::exact_unsigned::width_type::arbitrary)
+            {
+                check(name, IMD::to_string(IMD::surjective_mappings_128(n, m)), digits);
+                print(name + ", surjective_mappings_128", measure(calls, [&]
+                                                                   { keep(IMD::surjective_mappings_128(n, m)); }));
+            }
+            print(name + ", exact_surjective_mappings", measure(calls, [&]
+                                                                 { keep(IMD::exact_surjective_mappings(n, m)); }));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+#else
+    std::cerr << "The compiler has no 128-bit integers" << std::endl;
+    return 1;
+#endif
+}
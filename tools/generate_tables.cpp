@@ -0,0 +1,49 @@
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include "../include/tables.h"
+
+// Usage: generate_tables <Pascal|factorials|Catalan|Fibonacci> <size> <modulus> <path>
+// Zero modulus stores the exact values
+int main(int argc, char **argv)
+{
+    if (argc != 5)
+    {
+        std::cerr << "Usage: " << argv[0] << " <Pascal|factorials|Catalan|Fibonacci> <size> <modulus> <path>" << std::endl;
+        return 2;
+    }
+
+    const std::string name(argv[1]);
+    IMD::precomputed_table::kind k;
+    if (name == "Pascal")
+        k = IMD::precomputed_table::kind::Pascal_triangle;
+    else if (name == "factorials")
+        k = IMD::precomputed_table::kind::factorials;
+    else if (name == "Catalan")
+        k = IMD::precomputed_table::kind::Catalan_numbers;
+    else if (name == "Fibonacci")
+        k = IMD::precomputed_table::kind::Fibonacci_numbers;
+    else
+    {
+        std::cerr << "Unknown table '" << name << "'" << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        const unsigned long long size = std::stoull(argv[2]);
+        const unsigned long long modulus = std::stoull(argv[3]);
+
+        IMD::precomputed_table::generate(argv[4], k, size, modulus);
+
+        // Read the file back to make sure it is valid
+        IMD::precomputed_table table = IMD::precomputed_table::open(argv[4], k, modulus, true);
+        std::cout << "Written " << table.length() << " elements into '" << argv[4] << "'" << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}